@@ -1,13 +1,35 @@
 @echo off 
 SET INCLUDES=-I ..\ext -I ..\ext\glad\include -I ..\ext\GLFW\include
-SET SRC=..\code\main.cpp ..\ext\glad\src\glad.c
+SET SRC=..\code\main.cpp ..\code\mesh.cpp ..\code\vertex_format.cpp ..\code\geometry_pool.cpp ..\code\job_system.cpp ..\code\texture_loader.cpp ..\code\resource_registry.cpp ..\code\texture_bake.cpp ..\code\image_decode.cpp ..\code\virtual_texture.cpp ..\code\bc_encoder.cpp ..\code\mip_gen.cpp ..\code\asset_pack.cpp ..\code\lz4.cpp ..\code\memory_arena.cpp ..\code\alloc_tracker.cpp ..\code\startup.cpp ..\code\triple_buffer.cpp ..\code\input_latency.cpp ..\code\platform.cpp ..\ext\glad\src\glad.c
 SET WARNING_FLAGS=-W4 -WX -wd4100 -wd4101 -wd4189 -wd4996 -wd4530 -wd4201 -wd4505 -wd4098 -wd4700 -wd4127
 SET COMPILER_FLAGS=-nologo -FC -MDd -Zi %WARNING_FLAGS% %INCLUDES% -Fe:GL.exe
 SET LINKER_FLAGS=-debug -SUBSYSTEM:CONSOLE -IGNORE:4098 -LIBPATH:ext\GLFW ..\ext\GLFW\glfw3.lib opengl32.lib user32.lib gdi32.lib winmm.lib shell32.lib
 
+REM libjpeg-turbo is optional, without it JPEGs decode with stb_image
+SET JPEG_FLAGS=
+SET JPEG_LIBS=
+IF EXIST ext\libjpeg-turbo\lib\jpeg-static.lib (
+    SET JPEG_FLAGS=-DUSE_LIBJPEG_TURBO -I ..\ext\libjpeg-turbo\include
+    SET JPEG_LIBS=..\ext\libjpeg-turbo\lib\jpeg-static.lib
+)
+
 IF NOT EXIST .build MKDIR .build
 PUSHD .build
-CL %COMPILER_FLAGS% %SRC% -DDEVELOPER -link %LINKER_FLAGS%
+CL %COMPILER_FLAGS% %JPEG_FLAGS% %SRC% -DDEVELOPER -link %LINKER_FLAGS% %JPEG_LIBS%
+
+REM benchmarks
+SET BENCH_FLAGS=-nologo -FC -MD -O2 -Zi %WARNING_FLAGS% %INCLUDES%
+CL %BENCH_FLAGS% ..\code\vertex_bench.cpp ..\code\vertex_format.cpp ..\code\mesh.cpp -Fe:vertex_bench.exe -link -SUBSYSTEM:CONSOLE
+CL %BENCH_FLAGS% ..\code\bc_bench.cpp ..\code\bc_encoder.cpp ..\code\job_system.cpp ..\code\platform.cpp -Fe:bc_bench.exe -link -SUBSYSTEM:CONSOLE
+CL %BENCH_FLAGS% %JPEG_FLAGS% ..\code\jpeg_bench.cpp ..\code\image_decode.cpp ..\code\asset_pack.cpp ..\code\lz4.cpp ..\code\resource_registry.cpp ..\code\job_system.cpp ..\code\memory_arena.cpp ..\code\platform.cpp -Fe:jpeg_bench.exe -link -SUBSYSTEM:CONSOLE %JPEG_LIBS%
+CL %BENCH_FLAGS% ..\code\mip_bench.cpp ..\code\mip_gen.cpp ..\code\job_system.cpp ..\code\platform.cpp -Fe:mip_bench.exe -link -SUBSYSTEM:CONSOLE
+CL %BENCH_FLAGS% ..\code\io_bench.cpp ..\code\async_io.cpp ..\code\platform.cpp -Fe:io_bench.exe -link -SUBSYSTEM:CONSOLE
+
+REM tools
+CL %BENCH_FLAGS% ..\code\asset_packer.cpp ..\code\asset_pack.cpp ..\code\async_io.cpp ..\code\lz4.cpp ..\code\resource_registry.cpp ..\code\job_system.cpp ..\code\platform.cpp -Fe:asset_packer.exe -link -SUBSYSTEM:CONSOLE
 COPY *.exe ..
 
 POPD
+
+REM shaders and data/ into assets.pack, GL.exe loads loose files without it
+asset_packer.exe
@@ -0,0 +1,246 @@
+#ifdef DEVELOPER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include "alloc_tracker.h"
+
+#if defined(_WIN32) && defined(_DEBUG)
+#include <crtdbg.h>
+#define ALLOC_CRT_HOOK
+#endif
+
+// render loop allocations printed before going quiet
+#define ALLOC_MAX_REPORTS 16
+
+struct Alloc_Counters {
+    std::atomic<int64_t> allocations;
+    std::atomic<int64_t> bytes;
+};
+
+// Written by the owning thread, drained by the render thread each frame.
+// Threads claim a slot on their first allocation and keep it; past
+// ALLOC_MAX_THREADS they share the last one.
+struct Alloc_Thread {
+    Alloc_Counters frame[ALLOC_MAX_ZONES];
+    std::atomic<int64_t> frame_unexpected; // render thread outside allowed zones
+    std::atomic<int64_t> frees;
+
+    // render thread only
+    int64_t total_allocations[ALLOC_MAX_ZONES];
+    int64_t total_bytes[ALLOC_MAX_ZONES];
+    int64_t peak_frame_allocations;
+    int frames_allocating;
+    bool render;
+    bool in_report;
+};
+
+static Alloc_Thread alloc_threads[ALLOC_MAX_THREADS];
+static std::atomic<int> alloc_thread_count;
+static thread_local Alloc_Thread *alloc_thread;
+static thread_local int alloc_zone_current;
+static thread_local int alloc_allowed_depth;
+
+static std::mutex alloc_zone_mutex;
+static const char *alloc_zone_names[ALLOC_MAX_ZONES] = {"untagged"};
+static int alloc_zone_count = 1;
+
+static int alloc_warm_up_frames;
+static bool alloc_assert;
+static std::atomic<int> alloc_frame;
+static int alloc_reports;
+
+static Alloc_Thread *alloc_thread_get() {
+    if (!alloc_thread) {
+        int index = alloc_thread_count.fetch_add(1, std::memory_order_relaxed);
+        alloc_thread = &alloc_threads[index < ALLOC_MAX_THREADS ? index : ALLOC_MAX_THREADS - 1];
+    }
+    return alloc_thread;
+}
+
+static void alloc_record(size_t size) {
+    Alloc_Thread *thread = alloc_thread_get();
+    if (thread->in_report) return;
+    int zone = alloc_zone_current;
+    thread->frame[zone].allocations.fetch_add(1, std::memory_order_relaxed);
+    thread->frame[zone].bytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+    if (!thread->render || alloc_allowed_depth > 0) return;
+    thread->frame_unexpected.fetch_add(1, std::memory_order_relaxed);
+    if (alloc_assert && alloc_frame.load(std::memory_order_relaxed) > alloc_warm_up_frames) {
+        // the message allocates too, don't count it
+        thread->in_report = true;
+        printf("Heap allocation of %zu bytes in the render loop, zone %s\n", size, alloc_zone_names[zone]);
+        assert(!"heap allocation in the render loop");
+        thread->in_report = false;
+    }
+}
+
+static void alloc_record_free() {
+    alloc_thread_get()->frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef ALLOC_CRT_HOOK
+
+// Must not allocate, and CRT blocks must not touch the CRT at all
+static int alloc_crt_hook(int type, void *user_data, size_t size, int block_type, long request, const unsigned char *file, int line) {
+    if (_BLOCK_TYPE(block_type) == _CRT_BLOCK) return 1;
+    if (type == _HOOK_FREE) {
+        alloc_record_free();
+    } else {
+        alloc_record(size);
+    }
+    return 1;
+}
+
+#else
+
+void *operator new(size_t size) {
+    alloc_record(size);
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    alloc_record(size);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept {
+    if (pointer) alloc_record_free();
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    operator delete(pointer);
+}
+
+#endif // ALLOC_CRT_HOOK
+
+int alloc_zone_register(const char *name) {
+    std::lock_guard<std::mutex> lock(alloc_zone_mutex);
+    for (int i = 0; i < alloc_zone_count; i++) {
+        if (strcmp(alloc_zone_names[i], name) == 0) return i;
+    }
+    if (alloc_zone_count == ALLOC_MAX_ZONES) return 0;
+    alloc_zone_names[alloc_zone_count] = name;
+    return alloc_zone_count++;
+}
+
+Alloc_Zone_Scope::Alloc_Zone_Scope(int zone, bool allowed) : previous_zone(alloc_zone_current), allowed(allowed) {
+    alloc_zone_current = zone;
+    if (allowed) alloc_allowed_depth++;
+}
+
+Alloc_Zone_Scope::~Alloc_Zone_Scope() {
+    alloc_zone_current = previous_zone;
+    if (allowed) alloc_allowed_depth--;
+}
+
+void alloc_tracker_init(int warm_up_frames, bool assert_after_warm_up) {
+    alloc_warm_up_frames = warm_up_frames;
+    alloc_assert = assert_after_warm_up;
+#ifdef ALLOC_CRT_HOOK
+    _CrtSetAllocHook(alloc_crt_hook);
+#endif
+}
+
+static int alloc_thread_slots() {
+    int count = alloc_thread_count.load(std::memory_order_relaxed);
+    return count < ALLOC_MAX_THREADS ? count : ALLOC_MAX_THREADS;
+}
+
+// Moves the frame counts of every thread into the totals
+static void alloc_collect(bool report) {
+    for (int t = 0; t < alloc_thread_slots(); t++) {
+        Alloc_Thread *thread = &alloc_threads[t];
+        int64_t frame_allocations = 0;
+        int64_t frame_bytes = 0;
+        int worst_zone = 0;
+        int64_t worst = 0;
+        for (int z = 0; z < ALLOC_MAX_ZONES; z++) {
+            int64_t allocations = thread->frame[z].allocations.exchange(0, std::memory_order_relaxed);
+            int64_t bytes = thread->frame[z].bytes.exchange(0, std::memory_order_relaxed);
+            thread->total_allocations[z] += allocations;
+            thread->total_bytes[z] += bytes;
+            frame_allocations += allocations;
+            frame_bytes += bytes;
+            if (allocations > worst) {
+                worst = allocations;
+                worst_zone = z;
+            }
+        }
+        int64_t unexpected = thread->frame_unexpected.exchange(0, std::memory_order_relaxed);
+        if (frame_allocations > 0) thread->frames_allocating++;
+        if (frame_allocations > thread->peak_frame_allocations) thread->peak_frame_allocations = frame_allocations;
+
+        if (report && unexpected > 0 && alloc_reports < ALLOC_MAX_REPORTS) {
+            Alloc_Thread *self = alloc_thread_get();
+            self->in_report = true;
+            printf("Frame %d: %lld heap allocations, %lld bytes in the render loop, most in zone %s\n",
+                   alloc_frame.load(std::memory_order_relaxed) - 1, (long long)frame_allocations, (long long)frame_bytes, alloc_zone_names[worst_zone]);
+            if (++alloc_reports == ALLOC_MAX_REPORTS) printf("Not reporting further frames\n");
+            self->in_report = false;
+        }
+    }
+}
+
+void alloc_tracker_frame_begin() {
+    Alloc_Thread *self = alloc_thread_get();
+    self->render = true;
+    alloc_collect(alloc_frame.load(std::memory_order_relaxed) > alloc_warm_up_frames);
+    alloc_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void alloc_tracker_report() {
+    Alloc_Thread *self = alloc_thread_get();
+    alloc_collect(false);
+    self->in_report = true;
+    printf("Heap allocations over %d frames:\n", alloc_frame.load(std::memory_order_relaxed));
+    for (int t = 0; t < alloc_thread_slots(); t++) {
+        Alloc_Thread *thread = &alloc_threads[t];
+        int64_t allocations = 0;
+        for (int z = 0; z < ALLOC_MAX_ZONES; z++) allocations += thread->total_allocations[z];
+        if (allocations == 0) continue;
+        printf("  thread %d%s: %lld allocations, %lld frees, in %d frames, at most %lld in one\n", t, thread->render ? " (render)" : "",
+               (long long)allocations, (long long)thread->frees.load(std::memory_order_relaxed), thread->frames_allocating,
+               (long long)thread->peak_frame_allocations);
+        for (int z = 0; z < ALLOC_MAX_ZONES; z++) {
+            if (thread->total_allocations[z] == 0) continue;
+            printf("    %-24s %10lld %10.2f MB\n", alloc_zone_names[z], (long long)thread->total_allocations[z],
+                   thread->total_bytes[z] / (1024.0 * 1024.0));
+        }
+    }
+    self->in_report = false;
+}
+
+#endif // DEVELOPER
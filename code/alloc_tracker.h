@@ -0,0 +1,65 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <stdint.h>
+
+// Heap allocation tracking for DEVELOPER builds. Every allocation is counted
+// against the thread that made it and the zone active on that thread, and
+// the counts are gathered once per frame. After a warm-up, an allocation on
+// the render thread outside an allowed zone is reported, or fails an assert
+// where it happens, so a stray std::vector in the frame loop shows up long
+// before it shows up as a hitch.
+//
+// With the debug CRT on Windows a CRT allocation hook sees malloc, realloc,
+// free and operator new, which goes through malloc. Elsewhere the global
+// operator new and delete are replaced, so C++ allocations are counted but
+// plain malloc is not.
+//
+// Zones are scoped and nest, the innermost one is charged:
+//     ALLOC_ZONE("texture_loader");
+//     ALLOC_ZONE_ALLOWED("events"); // may allocate in the render loop
+//
+// Without DEVELOPER all of it compiles away.
+
+#define ALLOC_MAX_ZONES 32
+#define ALLOC_MAX_THREADS 64
+
+#ifdef DEVELOPER
+
+// warm_up_frames are not checked, e.g. while the first textures arrive.
+// With assert_after_warm_up an allocation asserts instead of being reported.
+void alloc_tracker_init(int warm_up_frames, bool assert_after_warm_up);
+// Call at the top of each frame. The calling thread is the render thread.
+void alloc_tracker_frame_begin();
+// Totals by thread and zone since init
+void alloc_tracker_report();
+
+int alloc_zone_register(const char *name);
+
+struct Alloc_Zone_Scope {
+    int previous_zone;
+    bool allowed;
+    Alloc_Zone_Scope(int zone, bool allowed);
+    ~Alloc_Zone_Scope();
+};
+
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_ZONE_SCOPE_(name, allowed) \
+    static const int ALLOC_CONCAT(alloc_zone_, __LINE__) = alloc_zone_register(name); \
+    Alloc_Zone_Scope ALLOC_CONCAT(alloc_zone_scope_, __LINE__)(ALLOC_CONCAT(alloc_zone_, __LINE__), allowed)
+#define ALLOC_ZONE(name) ALLOC_ZONE_SCOPE_(name, false)
+#define ALLOC_ZONE_ALLOWED(name) ALLOC_ZONE_SCOPE_(name, true)
+
+#else
+
+inline void alloc_tracker_init(int warm_up_frames, bool assert_after_warm_up) {}
+inline void alloc_tracker_frame_begin() {}
+inline void alloc_tracker_report() {}
+
+#define ALLOC_ZONE(name)
+#define ALLOC_ZONE_ALLOWED(name)
+
+#endif // DEVELOPER
+
+#endif // ALLOC_TRACKER_H
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "asset_pack.h"
+#include "lz4.h"
+#include "resource_registry.h"
+#include "job_system.h"
+
+static Asset_Pack mounted_pack;
+static bool pack_mounted;
+
+uint64_t asset_pack_hash(const char *path) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *c = path; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool range_inside(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+static bool asset_pack_validate(Asset_Pack *pack) {
+    uint64_t file_size = (uint64_t)pack->file.size;
+    if (file_size < sizeof(Asset_Pack_Header)) return false;
+    const Asset_Pack_Header *header = (const Asset_Pack_Header *)pack->file.data;
+    if (memcmp(header->identifier, ASSET_PACK_IDENTIFIER, sizeof(header->identifier)) != 0) return false;
+    if (header->version != ASSET_PACK_VERSION) return false;
+    if (header->table_size == 0 || (header->table_size & (header->table_size - 1)) != 0) return false;
+    if (header->table_size < header->entry_count) return false;
+    if (!range_inside(header->entries_offset, (uint64_t)header->entry_count * sizeof(Asset_Pack_Entry), file_size)) return false;
+    if (!range_inside(header->table_offset, (uint64_t)header->table_size * sizeof(uint32_t), file_size)) return false;
+    if (!range_inside(header->chunks_offset, (uint64_t)header->chunk_count * sizeof(Asset_Pack_Chunk), file_size)) return false;
+    if (!range_inside(header->names_offset, header->names_size, file_size)) return false;
+    if (header->names_size == 0 || ((const char *)pack->file.data)[header->names_offset + header->names_size - 1] != '\0') return false;
+    if (header->entries_offset % 8 || header->table_offset % 4 || header->chunks_offset % 8) return false;
+
+    const uint8_t *base = (const uint8_t *)pack->file.data;
+    pack->header = header;
+    pack->entries = (const Asset_Pack_Entry *)(base + header->entries_offset);
+    pack->table = (const uint32_t *)(base + header->table_offset);
+    pack->chunks = (const Asset_Pack_Chunk *)(base + header->chunks_offset);
+    pack->names = (const char *)(base + header->names_offset);
+
+    for (uint32_t i = 0; i < header->table_size; i++) {
+        if (pack->table[i] > header->entry_count) return false;
+    }
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const Asset_Pack_Entry *entry = &pack->entries[i];
+        if (entry->name_offset >= header->names_size) return false;
+        if (!range_inside(entry->offset, entry->stored_size, file_size)) return false;
+        if (entry->compression == ASSET_COMPRESSION_NONE) {
+            if (entry->stored_size != entry->size) return false;
+            continue;
+        }
+        if (entry->compression != ASSET_COMPRESSION_LZ4) return false;
+        if ((uint64_t)entry->first_chunk + entry->chunk_count > header->chunk_count) return false;
+        uint64_t size = 0;
+        for (uint32_t c = 0; c < entry->chunk_count; c++) {
+            const Asset_Pack_Chunk *chunk = &pack->chunks[entry->first_chunk + c];
+            if (!range_inside(chunk->offset, chunk->stored_size, entry->stored_size)) return false;
+            // chunks are decompressed to c * ASSET_PACK_CHUNK_SIZE, only the last is short
+            bool last = c + 1 == entry->chunk_count;
+            if (chunk->size > ASSET_PACK_CHUNK_SIZE || (!last && chunk->size != ASSET_PACK_CHUNK_SIZE)) return false;
+            size += chunk->size;
+        }
+        if (size != entry->size) return false;
+    }
+    return true;
+}
+
+bool asset_pack_open(Asset_Pack *pack, const char *path) {
+    *pack = {};
+    if (!platform_map_file(path, &pack->file)) return false;
+    if (!asset_pack_validate(pack)) {
+        printf("Invalid asset pack: %s\n", path);
+        asset_pack_close(pack);
+        return false;
+    }
+    return true;
+}
+
+void asset_pack_close(Asset_Pack *pack) {
+    platform_unmap_file(&pack->file);
+    *pack = {};
+}
+
+const char *asset_pack_entry_name(const Asset_Pack *pack, const Asset_Pack_Entry *entry) {
+    return pack->names + entry->name_offset;
+}
+
+const Asset_Pack_Entry *asset_pack_find(const Asset_Pack *pack, const char *path) {
+    char key[RESOURCE_KEY_SIZE];
+    resource_normalize_path(path, key, sizeof(key));
+    uint64_t hash = asset_pack_hash(key);
+    uint32_t mask = pack->header->table_size - 1;
+    // linear probing, the table is at most half full
+    for (uint32_t i = 0; i <= mask; i++) {
+        uint32_t slot = pack->table[(hash + i) & mask];
+        if (slot == 0) return NULL;
+        const Asset_Pack_Entry *entry = &pack->entries[slot - 1];
+        if (entry->hash == hash && strcmp(asset_pack_entry_name(pack, entry), key) == 0) return entry;
+    }
+    return NULL;
+}
+
+// On the caller's stack, job_parallel_for returns once every chunk is done
+struct Asset_Decompress_Job {
+    const uint8_t *source;
+    const Asset_Pack_Chunk *chunks;
+    uint8_t *out;
+    std::atomic<bool> failed;
+};
+
+static void decompress_chunks(void *data, int begin, int end) {
+    Asset_Decompress_Job *job = (Asset_Decompress_Job *)data;
+    for (int c = begin; c < end; c++) {
+        const Asset_Pack_Chunk *chunk = &job->chunks[c];
+        uint8_t *out = job->out + (uint64_t)c * ASSET_PACK_CHUNK_SIZE;
+        int size = lz4_decompress(job->source + chunk->offset, (int)chunk->stored_size, out, (int)chunk->size);
+        if (size != (int)chunk->size) job->failed = true;
+    }
+}
+
+bool asset_pack_decompress(const Asset_Pack *pack, const Asset_Pack_Entry *entry, uint8_t *out) {
+    const uint8_t *source = (const uint8_t *)pack->file.data + entry->offset;
+    if (entry->compression == ASSET_COMPRESSION_NONE) {
+        memcpy(out, source, (size_t)entry->size);
+        return true;
+    }
+
+    Asset_Decompress_Job job;
+    job.source = source;
+    job.chunks = &pack->chunks[entry->first_chunk];
+    job.out = out;
+    job.failed = false;
+    job_parallel_for((int)entry->chunk_count, 1, decompress_chunks, &job);
+    return !job.failed;
+}
+
+bool asset_mount(const char *pack_path) {
+    if (pack_mounted) asset_unmount();
+    if (!asset_pack_open(&mounted_pack, pack_path)) return false;
+    // startup reads most of it, start paging it in now
+    platform_advise(&mounted_pack.file, 0, 0, PLATFORM_ACCESS_WILLNEED);
+    pack_mounted = true;
+    return true;
+}
+
+void asset_unmount() {
+    if (pack_mounted) asset_pack_close(&mounted_pack);
+    pack_mounted = false;
+}
+
+bool asset_open(const char *path, Asset_File *out_file) {
+    *out_file = {};
+    const Asset_Pack_Entry *entry = pack_mounted ? asset_pack_find(&mounted_pack, path) : NULL;
+    if (!entry) {
+        if (!platform_map_file(path, &out_file->file)) return false;
+        platform_advise(&out_file->file, 0, 0, PLATFORM_ACCESS_SEQUENTIAL);
+        out_file->data = (const uint8_t *)out_file->file.data;
+        out_file->size = out_file->file.size;
+        return true;
+    }
+
+    if (entry->compression == ASSET_COMPRESSION_NONE) {
+        out_file->data = (const uint8_t *)mounted_pack.file.data + entry->offset;
+        out_file->size = (int64_t)entry->size;
+        return true;
+    }
+    out_file->decompressed = (uint8_t *)malloc((size_t)entry->size);
+    if (!out_file->decompressed || !asset_pack_decompress(&mounted_pack, entry, out_file->decompressed)) {
+        printf("Failed to decompress %s from the asset pack\n", path);
+        free(out_file->decompressed);
+        *out_file = {};
+        return false;
+    }
+    out_file->data = out_file->decompressed;
+    out_file->size = (int64_t)entry->size;
+    return true;
+}
+
+void asset_close(Asset_File *file) {
+    free(file->decompressed);
+    if (file->file.data) platform_unmap_file(&file->file);
+    *file = {};
+}
+
+int64_t asset_mtime(const char *path) {
+    const Asset_Pack_Entry *entry = pack_mounted ? asset_pack_find(&mounted_pack, path) : NULL;
+    return entry ? entry->mtime : platform_file_mtime(path);
+}
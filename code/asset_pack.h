@@ -0,0 +1,105 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stdint.h>
+
+#include "platform.h"
+
+// Every shader and everything under data/ packed into one file by
+// asset_packer. At runtime the pack is one mapping and a path lookup is a
+// hash and a probe or two into the table of contents, instead of an open
+// per file. Uncompressed entries are used straight from the mapping;
+// compressed ones are LZ4 in independent chunks, decompressed in parallel
+// on the job system.
+//
+// Layout: header, entries, hash table, chunks, names, then the data of each
+// entry at a multiple of its alignment. All offsets are 64-bit.
+
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_PATH "assets.pack"
+// uncompressed bytes per LZ4 chunk
+#define ASSET_PACK_CHUNK_SIZE (256 * 1024)
+
+static const uint8_t ASSET_PACK_IDENTIFIER[12] = {0xAB, 'G', 'L', 'P', 'A', 'K', ' ', '1', 0xBB, '\r', '\n', 0x1A};
+
+enum Asset_Compression {
+    ASSET_COMPRESSION_NONE,
+    ASSET_COMPRESSION_LZ4,
+};
+
+struct Asset_Pack_Header {
+    uint8_t identifier[12];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t table_size;  // hash table slots, a power of two
+    uint32_t chunk_count;
+    uint64_t entries_offset; // Asset_Pack_Entry[entry_count]
+    uint64_t table_offset;   // uint32_t[table_size], entry index + 1, 0 when empty
+    uint64_t chunks_offset;  // Asset_Pack_Chunk[chunk_count]
+    uint64_t names_offset;   // normalized paths, NUL terminated
+    uint64_t names_size;
+};
+
+struct Asset_Pack_Entry {
+    uint64_t hash;        // asset_pack_hash of the normalized path
+    uint64_t offset;      // of the data from the start of the file
+    uint64_t size;        // uncompressed
+    uint64_t stored_size; // in the file
+    int64_t mtime;        // of the source when packed
+    uint32_t name_offset; // from names_offset
+    uint32_t alignment;   // offset is a multiple of it, so data can go to the GPU as is
+    uint32_t compression;
+    uint32_t first_chunk; // LZ4 entries only
+    uint32_t chunk_count;
+    uint32_t reserved;
+};
+
+// A chunk holds ASSET_PACK_CHUNK_SIZE bytes of the entry, less for the last
+struct Asset_Pack_Chunk {
+    uint64_t offset; // from the entry offset
+    uint32_t stored_size;
+    uint32_t size;
+};
+
+struct Asset_Pack {
+    Platform_Mapped_File file;
+    const Asset_Pack_Header *header;
+    const Asset_Pack_Entry *entries;
+    const uint32_t *table;
+    const Asset_Pack_Chunk *chunks;
+    const char *names;
+};
+
+// FNV-1a of a normalized path
+uint64_t asset_pack_hash(const char *path);
+
+// Maps the pack and checks every table against the file size once, so
+// lookups and reads can trust it
+bool asset_pack_open(Asset_Pack *pack, const char *path);
+void asset_pack_close(Asset_Pack *pack);
+// NULL if the path is not in the pack
+const Asset_Pack_Entry *asset_pack_find(const Asset_Pack *pack, const char *path);
+const char *asset_pack_entry_name(const Asset_Pack *pack, const Asset_Pack_Entry *entry);
+// Decompresses entry->size bytes into out. The chunks are a parallel for
+// the caller takes part in, so it is safe on a worker, and without the job
+// system it all runs on the caller.
+bool asset_pack_decompress(const Asset_Pack *pack, const Asset_Pack_Entry *entry, uint8_t *out);
+
+// The mounted pack. Loaders open files through these, which read from the
+// pack when it holds the path and from the loose file otherwise. Mount
+// before any loads start and unmount after they are done.
+struct Asset_File {
+    const uint8_t *data;
+    int64_t size;
+    Platform_Mapped_File file; // loose files only
+    uint8_t *decompressed;     // compressed entries only
+};
+
+bool asset_mount(const char *pack_path);
+void asset_unmount();
+bool asset_open(const char *path, Asset_File *out_file);
+void asset_close(Asset_File *file);
+// Modification time of the packed source or the loose file, -1 if neither
+int64_t asset_mtime(const char *path);
+
+#endif // ASSET_PACK_H
@@ -0,0 +1,272 @@
+// Packs every .glsl file in the working directory and everything under
+// data/ into one asset pack, see asset_pack.h. Run from the repository
+// root after building:
+//     asset_packer [-o assets.pack] [-nocompress]
+// Entries that LZ4 does not shrink by at least an eighth, like the JPEGs and
+// PNGs, are stored as they are.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stb_ds.h>
+
+#include "asset_pack.h"
+#include "async_io.h"
+#include "lz4.h"
+#include "platform.h"
+#include "resource_registry.h"
+
+// small entries only need cache line alignment, large ones start on a page
+// so their pages are never shared with a neighbour
+#define PACK_ALIGNMENT 64
+#define PACK_PAGE_ALIGNMENT 4096
+#define PACK_PAGE_ALIGN_SIZE (64 * 1024)
+
+struct Pack_Source {
+    char *path; // normalized
+    int64_t mtime;
+    uint8_t *data; // as stored
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t compression;
+    uint32_t alignment;
+    Asset_Pack_Chunk *chunks; // stb_ds array, LZ4 only
+};
+
+static void add_source(const char *path, Pack_Source **sources) {
+    Pack_Source source = {};
+    char key[RESOURCE_KEY_SIZE];
+    resource_normalize_path(path, key, sizeof(key));
+    source.path = (char *)malloc(strlen(key) + 1);
+    strcpy(source.path, key);
+    arrput(*sources, source);
+}
+
+static void add_shader(const char *path, void *data) {
+    size_t length = strlen(path);
+    if (length > 5 && strcmp(path + length - 5, ".glsl") == 0) add_source(path, (Pack_Source **)data);
+}
+
+static void add_data(const char *path, void *data) {
+    add_source(path, (Pack_Source **)data);
+}
+
+static int compare_sources(const void *a, const void *b) {
+    return strcmp(((const Pack_Source *)a)->path, ((const Pack_Source *)b)->path);
+}
+
+// Takes the buffer of a finished read
+static bool take_source(Pack_Source *source, Async_Read *read) {
+    source->data = (uint8_t *)read->buffer;
+    source->size = read->size > 0 ? (uint64_t)read->size : 0;
+    source->mtime = platform_file_mtime(source->path);
+    source->stored_size = source->size;
+    source->compression = ASSET_COMPRESSION_NONE;
+    source->alignment = source->size >= PACK_PAGE_ALIGN_SIZE ? PACK_PAGE_ALIGNMENT : PACK_ALIGNMENT;
+    return read->bytes_read >= 0 && read->bytes_read == read->size;
+}
+
+// Replaces the data with independent LZ4 chunks when that saves enough
+static void compress_source(Pack_Source *source) {
+    if (source->size == 0) return;
+    uint64_t chunk_count = (source->size + ASSET_PACK_CHUNK_SIZE - 1) / ASSET_PACK_CHUNK_SIZE;
+    uint8_t *stored = (uint8_t *)malloc((size_t)(chunk_count * lz4_compress_bound(ASSET_PACK_CHUNK_SIZE)));
+    Asset_Pack_Chunk *chunks = NULL;
+    uint64_t stored_size = 0;
+    for (uint64_t offset = 0; offset < source->size; offset += ASSET_PACK_CHUNK_SIZE) {
+        int size = (int)(source->size - offset < ASSET_PACK_CHUNK_SIZE ? source->size - offset : ASSET_PACK_CHUNK_SIZE);
+        Asset_Pack_Chunk chunk = {};
+        chunk.offset = stored_size;
+        chunk.size = (uint32_t)size;
+        chunk.stored_size = (uint32_t)lz4_compress(source->data + offset, size, stored + stored_size, lz4_compress_bound(size));
+        stored_size += chunk.stored_size;
+        arrput(chunks, chunk);
+    }
+
+    if (stored_size * 8 > source->size * 7) {
+        free(stored);
+        arrfree(chunks);
+        return;
+    }
+    free(source->data);
+    source->data = stored;
+    source->stored_size = stored_size;
+    source->compression = ASSET_COMPRESSION_LZ4;
+    source->chunks = chunks;
+}
+
+static uint64_t align_up(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static void write_padding(FILE *fp, uint64_t *offset, uint64_t alignment) {
+    static const uint8_t zeros[PACK_PAGE_ALIGNMENT] = {};
+    uint64_t padding = align_up(*offset, alignment) - *offset;
+    fwrite(zeros, 1, (size_t)padding, fp);
+    *offset += padding;
+}
+
+static void write_bytes(FILE *fp, uint64_t *offset, const void *data, uint64_t size) {
+    fwrite(data, 1, (size_t)size, fp);
+    *offset += size;
+}
+
+static bool write_pack(Pack_Source *sources, const char *out_path) {
+    int count = (int)arrlen(sources);
+    uint32_t table_size = 2;
+    while (table_size < (uint32_t)count * 2) table_size *= 2;
+
+    Asset_Pack_Header header = {};
+    memcpy(header.identifier, ASSET_PACK_IDENTIFIER, sizeof(header.identifier));
+    header.version = ASSET_PACK_VERSION;
+    header.entry_count = (uint32_t)count;
+    header.table_size = table_size;
+
+    Asset_Pack_Entry *entries = (Asset_Pack_Entry *)calloc(count + 1, sizeof(Asset_Pack_Entry));
+    uint32_t *table = (uint32_t *)calloc(table_size, sizeof(uint32_t));
+    Asset_Pack_Chunk *chunks = NULL;
+    char *names = NULL;
+    for (int i = 0; i < count; i++) {
+        Pack_Source *source = &sources[i];
+        Asset_Pack_Entry *entry = &entries[i];
+        entry->hash = asset_pack_hash(source->path);
+        entry->size = source->size;
+        entry->stored_size = source->stored_size;
+        entry->mtime = source->mtime;
+        entry->name_offset = (uint32_t)arrlen(names);
+        entry->alignment = source->alignment;
+        entry->compression = source->compression;
+        entry->first_chunk = (uint32_t)arrlen(chunks);
+        entry->chunk_count = (uint32_t)arrlen(source->chunks);
+        for (int c = 0; c < arrlen(source->chunks); c++) arrput(chunks, source->chunks[c]);
+        for (const char *c = source->path; ; c++) {
+            arrput(names, *c);
+            if (!*c) break;
+        }
+
+        uint32_t slot = (uint32_t)entry->hash & (table_size - 1);
+        while (table[slot]) slot = (slot + 1) & (table_size - 1);
+        table[slot] = (uint32_t)i + 1;
+    }
+    header.chunk_count = (uint32_t)arrlen(chunks);
+
+    uint64_t offset = sizeof(header);
+    header.entries_offset = offset = align_up(offset, 8);
+    offset += (uint64_t)count * sizeof(Asset_Pack_Entry);
+    header.table_offset = offset;
+    offset += (uint64_t)table_size * sizeof(uint32_t);
+    header.chunks_offset = offset = align_up(offset, 8);
+    offset += (uint64_t)header.chunk_count * sizeof(Asset_Pack_Chunk);
+    header.names_offset = offset;
+    header.names_size = (uint64_t)arrlen(names);
+    offset += header.names_size;
+    for (int i = 0; i < count; i++) {
+        entries[i].offset = offset = align_up(offset, entries[i].alignment);
+        offset += entries[i].stored_size;
+    }
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", out_path);
+    FILE *fp = fopen(temp_path, "wb");
+    bool ok = fp != NULL;
+    if (fp) {
+        uint64_t written = 0;
+        write_bytes(fp, &written, &header, sizeof(header));
+        write_padding(fp, &written, 8);
+        write_bytes(fp, &written, entries, (uint64_t)count * sizeof(Asset_Pack_Entry));
+        write_bytes(fp, &written, table, (uint64_t)table_size * sizeof(uint32_t));
+        write_padding(fp, &written, 8);
+        write_bytes(fp, &written, chunks, (uint64_t)header.chunk_count * sizeof(Asset_Pack_Chunk));
+        write_bytes(fp, &written, names, header.names_size);
+        for (int i = 0; i < count; i++) {
+            write_padding(fp, &written, entries[i].alignment);
+            write_bytes(fp, &written, sources[i].data, sources[i].stored_size);
+        }
+        ok = !ferror(fp) && written == offset;
+        ok = fclose(fp) == 0 && ok;
+    }
+    ok = ok && platform_replace_file(temp_path, out_path);
+    if (!ok) {
+        printf("Failed to write %s\n", out_path);
+        remove(temp_path);
+    }
+
+    free(entries);
+    free(table);
+    arrfree(chunks);
+    arrfree(names);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = ASSET_PACK_PATH;
+    bool compress = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "-nocompress") == 0) {
+            compress = false;
+        } else {
+            printf("usage: asset_packer [-o %s] [-nocompress]\n", ASSET_PACK_PATH);
+            return 1;
+        }
+    }
+
+    Pack_Source *sources = NULL;
+    platform_list_files(".", false, add_shader, &sources);
+    if (!platform_list_files("data", true, add_data, &sources)) {
+        printf("No data directory, run from the repository root\n");
+        return 1;
+    }
+    qsort(sources, arrlen(sources), sizeof(Pack_Source), compare_sources);
+
+    // every file is read at once, each compresses as soon as it is in
+    int count = (int)arrlen(sources);
+    Async_Read *reads = new Async_Read[count]();
+    Async_Read **batch = (Async_Read **)malloc(count * sizeof(Async_Read *));
+    for (int i = 0; i < count; i++) {
+        reads[i].path = sources[i].path;
+        reads[i].size = -1;
+        batch[i] = &reads[i];
+    }
+    async_io_init(true);
+    async_io_submit(batch, count);
+
+    uint64_t total_size = 0;
+    uint64_t total_stored = 0;
+    bool ok = true;
+    int taken = 0;
+    for (; taken < count; taken++) {
+        Pack_Source *source = &sources[taken];
+        async_io_wait(&reads[taken]);
+        if (!take_source(source, &reads[taken])) {
+            printf("Failed to read %s\n", source->path);
+            ok = false;
+            taken++;
+            break;
+        }
+        if (compress) compress_source(source);
+        total_size += source->size;
+        total_stored += source->stored_size;
+    }
+    async_io_shutdown();
+    for (int i = taken; i < count; i++) {
+        if (reads[i].owns_buffer) free(reads[i].buffer);
+    }
+    delete[] reads;
+    free(batch);
+    ok = ok && write_pack(sources, out_path);
+    if (ok) {
+        printf("Packed %d files, %.2f MB -> %.2f MB, into %s\n", (int)arrlen(sources),
+               total_size / (1024.0 * 1024.0), total_stored / (1024.0 * 1024.0), out_path);
+    }
+
+    for (int i = 0; i < arrlen(sources); i++) {
+        free(sources[i].path);
+        free(sources[i].data);
+        arrfree(sources[i].chunks);
+    }
+    arrfree(sources);
+    return ok ? 0 : 1;
+}
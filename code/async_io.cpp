@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include "async_io.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING
+#endif
+#endif
+
+#ifdef ASYNC_IO_URING
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+static std::mutex io_mutex;
+static std::condition_variable io_cv;      // reads waiting, for the pool
+static std::condition_variable io_done_cv; // a read finished
+static Async_Read *io_pending_head;
+static Async_Read *io_pending_tail;
+static bool io_quit;
+static bool io_uring_active;
+static std::vector<std::thread> io_threads;
+static const char *io_backend = "none";
+
+// Call with io_mutex held
+static Async_Read *pop_pending() {
+    Async_Read *read = io_pending_head;
+    if (read) {
+        io_pending_head = read->next;
+        if (!io_pending_head) io_pending_tail = NULL;
+    }
+    return read;
+}
+
+// Opens the file and finds the buffer; false fails the read
+static bool begin_read(Async_Read *read) {
+    if (!platform_stream_open(read->path, &read->stream)) return false;
+    if (read->size < 0) {
+        read->size = read->stream.size > read->offset ? read->stream.size - read->offset : 0;
+    }
+    if (!read->buffer) {
+        read->buffer = malloc(read->size > 0 ? (size_t)read->size : 1);
+        read->owns_buffer = true;
+    }
+    return read->buffer != NULL;
+}
+
+static void finish_read(Async_Read *read, int64_t bytes_read) {
+    platform_stream_close(&read->stream);
+    if (bytes_read < 0 && read->owns_buffer) {
+        free(read->buffer);
+        read->buffer = NULL;
+    }
+    read->bytes_read = bytes_read;
+    if (read->done) read->done(read);
+    {
+        std::lock_guard<std::mutex> lock(io_mutex);
+        read->finished = true;
+    }
+    io_done_cv.notify_all();
+}
+
+static void pool_worker() {
+    for (;;) {
+        Async_Read *read;
+        {
+            std::unique_lock<std::mutex> lock(io_mutex);
+            io_cv.wait(lock, [] { return io_quit || io_pending_head; });
+            if (io_quit) return;
+            read = pop_pending();
+        }
+        int64_t bytes_read = -1;
+        if (begin_read(read)) {
+            bytes_read = platform_stream_read_at(&read->stream, read->buffer, read->size, read->offset);
+        }
+        finish_read(read, bytes_read);
+    }
+}
+
+#ifdef ASYNC_IO_URING
+// The rings are shared with the kernel: it moves sq_head and cq_tail, this
+// thread moves sq_tail and cq_head
+struct Io_Uring {
+    int fd;
+    int wake_fd; // eventfd polled through the ring, written on submit
+    uint8_t *sq_ring;
+    uint8_t *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    io_uring_cqe *cqes;
+};
+
+static Io_Uring uring;
+// reads in flight by slot; user_data is the slot + 1, 0 is the wake poll
+static Async_Read *uring_slots[ASYNC_IO_QUEUE_DEPTH];
+static int64_t uring_done[ASYNC_IO_QUEUE_DEPTH];
+static iovec uring_iovecs[ASYNC_IO_QUEUE_DEPTH];
+
+static void uring_teardown() {
+    if (uring.sqes) munmap(uring.sqes, uring.sqes_size);
+    if (uring.cq_ring && uring.cq_ring != uring.sq_ring) munmap(uring.cq_ring, uring.cq_ring_size);
+    if (uring.sq_ring) munmap(uring.sq_ring, uring.sq_ring_size);
+    if (uring.wake_fd >= 0) close(uring.wake_fd);
+    if (uring.fd >= 0) close(uring.fd);
+    uring = {};
+    uring.fd = -1;
+    uring.wake_fd = -1;
+}
+
+static bool uring_setup() {
+    uring = {};
+    uring.wake_fd = -1;
+    io_uring_params params = {};
+    // room for every read in flight being resubmitted plus the wake poll
+    uring.fd = (int)syscall(__NR_io_uring_setup, ASYNC_IO_QUEUE_DEPTH * 2, &params);
+    if (uring.fd < 0) return false;
+
+    uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        if (uring.cq_ring_size > uring.sq_ring_size) uring.sq_ring_size = uring.cq_ring_size;
+        uring.cq_ring_size = uring.sq_ring_size;
+    }
+    void *sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        uring_teardown();
+        return false;
+    }
+    uring.sq_ring = (uint8_t *)sq_ring;
+    if (single_mmap) {
+        uring.cq_ring = uring.sq_ring;
+    } else {
+        void *cq_ring = mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            uring_teardown();
+            return false;
+        }
+        uring.cq_ring = (uint8_t *)cq_ring;
+    }
+    uring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        uring_teardown();
+        return false;
+    }
+    uring.sqes = (io_uring_sqe *)sqes;
+
+    uring.sq_head = (unsigned *)(uring.sq_ring + params.sq_off.head);
+    uring.sq_tail = (unsigned *)(uring.sq_ring + params.sq_off.tail);
+    uring.sq_mask = (unsigned *)(uring.sq_ring + params.sq_off.ring_mask);
+    uring.sq_array = (unsigned *)(uring.sq_ring + params.sq_off.array);
+    uring.cq_head = (unsigned *)(uring.cq_ring + params.cq_off.head);
+    uring.cq_tail = (unsigned *)(uring.cq_ring + params.cq_off.tail);
+    uring.cq_mask = (unsigned *)(uring.cq_ring + params.cq_off.ring_mask);
+    uring.cqes = (io_uring_cqe *)(uring.cq_ring + params.cq_off.cqes);
+
+    uring.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (uring.wake_fd < 0) {
+        uring_teardown();
+        return false;
+    }
+    return true;
+}
+
+static void uring_push(const io_uring_sqe *sqe) {
+    unsigned tail = *uring.sq_tail;
+    unsigned head = __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+    // at most one entry per slot and the wake poll are ever queued
+    assert(tail - head <= *uring.sq_mask);
+    unsigned index = tail & *uring.sq_mask;
+    uring.sqes[index] = *sqe;
+    uring.sq_array[index] = index;
+    __atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void uring_queue_read(int slot) {
+    Async_Read *read = uring_slots[slot];
+    int64_t done = uring_done[slot];
+    int64_t size = read->size - done;
+    // the kernel caps one read a little under 2GB anyway
+    if (size > 0x40000000) size = 0x40000000;
+    uring_iovecs[slot].iov_base = (uint8_t *)read->buffer + done;
+    uring_iovecs[slot].iov_len = (size_t)size;
+
+    io_uring_sqe sqe = {};
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = (int)(intptr_t)read->stream.handle - 1; // the descriptor + 1, see platform.cpp
+    sqe.off = (uint64_t)(read->offset + done);
+    sqe.addr = (uint64_t)(uintptr_t)&uring_iovecs[slot];
+    sqe.len = 1;
+    sqe.user_data = (uint64_t)slot + 1;
+    uring_push(&sqe);
+}
+
+static void uring_arm_wake() {
+    io_uring_sqe sqe = {};
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = uring.wake_fd;
+    sqe.poll_events = POLLIN;
+    sqe.user_data = 0;
+    uring_push(&sqe);
+}
+
+static void uring_worker() {
+    int free_slots[ASYNC_IO_QUEUE_DEPTH];
+    int free_count = ASYNC_IO_QUEUE_DEPTH;
+    for (int i = 0; i < ASYNC_IO_QUEUE_DEPTH; i++) free_slots[i] = ASYNC_IO_QUEUE_DEPTH - 1 - i;
+    int in_flight = 0;
+    bool quit = false;
+    uring_arm_wake();
+
+    for (;;) {
+        // start as many waiting reads as there are free slots
+        while (!quit && free_count > 0) {
+            Async_Read *read;
+            {
+                std::lock_guard<std::mutex> lock(io_mutex);
+                quit = io_quit;
+                read = quit ? NULL : pop_pending();
+            }
+            if (!read) break;
+            if (!begin_read(read)) {
+                finish_read(read, -1);
+                continue;
+            }
+            if (read->size == 0) {
+                finish_read(read, 0);
+                continue;
+            }
+            int slot = free_slots[--free_count];
+            uring_slots[slot] = read;
+            uring_done[slot] = 0;
+            uring_queue_read(slot);
+            in_flight++;
+        }
+        if (quit && in_flight == 0) break;
+
+        // submit everything queued and sleep until something completes; the
+        // wake poll completes when more reads are submitted
+        unsigned to_submit = *uring.sq_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+        long result = syscall(__NR_io_uring_enter, uring.fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            printf("io_uring_enter failed: %s\n", strerror(errno));
+        }
+
+        unsigned head = *uring.cq_head;
+        unsigned tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+            if (cqe->user_data == 0) {
+                uint64_t count;
+                ssize_t drained = ::read(uring.wake_fd, &count, sizeof(count));
+                (void)drained;
+                uring_arm_wake();
+                continue;
+            }
+            int slot = (int)cqe->user_data - 1;
+            Async_Read *read = uring_slots[slot];
+            int res = cqe->res;
+            if (res == -EAGAIN || res == -EINTR) {
+                uring_queue_read(slot);
+                continue;
+            }
+            if (res > 0) {
+                uring_done[slot] += res;
+                if (uring_done[slot] < read->size) {
+                    uring_queue_read(slot); // short read, carry on from there
+                    continue;
+                }
+            }
+            finish_read(read, res < 0 ? -1 : uring_done[slot]);
+            free_slots[free_count++] = slot;
+            in_flight--;
+        }
+        __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+#endif
+
+void async_io_init(bool use_uring) {
+    assert(io_threads.empty());
+    io_quit = false;
+    io_uring_active = false;
+#ifdef ASYNC_IO_URING
+    if (use_uring && uring_setup()) {
+        io_uring_active = true;
+        io_backend = "io_uring";
+        io_threads.emplace_back(uring_worker);
+        return;
+    }
+#endif
+    io_backend = "thread pool";
+    for (int i = 0; i < ASYNC_IO_FALLBACK_THREADS; i++) {
+        io_threads.emplace_back(pool_worker);
+    }
+}
+
+static void wake_io_threads() {
+#ifdef ASYNC_IO_URING
+    if (io_uring_active) {
+        uint64_t one = 1;
+        ssize_t written = write(uring.wake_fd, &one, sizeof(one));
+        (void)written;
+        return;
+    }
+#endif
+    io_cv.notify_all();
+}
+
+void async_io_shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(io_mutex);
+        io_quit = true;
+    }
+    wake_io_threads();
+    for (std::thread &thread : io_threads) {
+        thread.join();
+    }
+    io_threads.clear();
+#ifdef ASYNC_IO_URING
+    if (io_uring_active) uring_teardown();
+#endif
+    io_uring_active = false;
+
+    Async_Read *dropped;
+    {
+        std::lock_guard<std::mutex> lock(io_mutex);
+        dropped = io_pending_head;
+        io_pending_head = io_pending_tail = NULL;
+    }
+    while (dropped) {
+        Async_Read *next = dropped->next;
+        finish_read(dropped, -1);
+        dropped = next;
+    }
+}
+
+void async_io_submit(Async_Read **reads, int count) {
+    assert(!io_threads.empty());
+    if (count <= 0) return;
+    for (int i = 0; i < count; i++) {
+        Async_Read *read = reads[i];
+        read->bytes_read = -1;
+        read->finished = false;
+        read->stream = {};
+        read->owns_buffer = false;
+        read->next = i + 1 < count ? reads[i + 1] : NULL;
+    }
+    {
+        std::lock_guard<std::mutex> lock(io_mutex);
+        if (io_pending_tail) {
+            io_pending_tail->next = reads[0];
+        } else {
+            io_pending_head = reads[0];
+        }
+        io_pending_tail = reads[count - 1];
+    }
+    wake_io_threads();
+}
+
+void async_io_wait(Async_Read *read) {
+    std::unique_lock<std::mutex> lock(io_mutex);
+    io_done_cv.wait(lock, [read] { return read->finished.load(); });
+}
+
+const char *async_io_backend_name() {
+    return io_backend;
+}
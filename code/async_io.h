@@ -0,0 +1,56 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "platform.h"
+
+// Asynchronous reads for loads that do not map the file. Reads are submitted
+// in batches and many are kept in flight at once; each completes into the
+// caller's buffer, or one it allocates, then calls its callback. On Linux one
+// thread drives an io_uring, set up with the raw syscalls. Where there is no
+// io_uring (old kernels, seccomp, Windows) a few threads do blocking
+// positioned reads instead. Either way the submitting thread never blocks
+// on the disk, so decoding on the job system overlaps the reads.
+
+#define ASYNC_IO_QUEUE_DEPTH 64
+#define ASYNC_IO_FALLBACK_THREADS 4
+
+struct Async_Read;
+// Runs on an I/O thread, keep it short, e.g. hand the decode to job_run
+typedef void (*Async_Read_Proc)(Async_Read *read);
+
+struct Async_Read {
+    // set by the caller
+    const char *path;
+    int64_t offset;
+    int64_t size;         // -1 reads to the end of the file, and is set to that size
+    void *buffer;         // at least size bytes, or NULL to have one malloc'd
+    Async_Read_Proc done; // may be NULL
+    void *data;
+
+    // finished is set after done returns, and the backend is done with the
+    // request from then on
+    int64_t bytes_read;   // short at the end of the file, -1 on error
+    std::atomic<bool> finished;
+
+    // backend state
+    Platform_File_Stream stream;
+    bool owns_buffer;
+    Async_Read *next;
+};
+
+// use_uring false forces the thread pool, e.g. to compare the two
+void async_io_init(bool use_uring);
+// Finishes the reads in flight. Reads not started yet fail with -1.
+void async_io_shutdown();
+
+// The requests must stay alive, unmoved, until they finish
+void async_io_submit(Async_Read **reads, int count);
+void async_io_wait(Async_Read *read);
+
+// "io_uring" or "thread pool"
+const char *async_io_backend_name();
+
+#endif // ASYNC_IO_H
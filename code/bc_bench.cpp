@@ -0,0 +1,95 @@
+// Block compression quality and throughput on the material textures.
+// Reports PSNR over the channels each format stores and megapixels per second,
+// single threaded and on every core.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "bc_encoder.h"
+#include "job_system.h"
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int format_channels(Bc_Format format) {
+    switch (format) {
+    case BC_FORMAT_BC1: return 3;
+    case BC_FORMAT_BC4: return 1;
+    case BC_FORMAT_BC5: return 2;
+    default: return 4;
+    }
+}
+
+static double psnr(const uint8_t *a, const uint8_t *b, int pixel_count, int channels) {
+    double sum = 0.0;
+    for (int i = 0; i < pixel_count; i++) {
+        for (int c = 0; c < channels; c++) {
+            double d = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / ((double)pixel_count * channels);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int main(int argc, char **argv) {
+    const char *default_paths[] = {
+        "data/container2.png",
+        "data/container2_specular.png",
+        "data/cage.png",
+        "data/skybox/front.jpg",
+    };
+    const char **paths = default_paths;
+    int path_count = sizeof(default_paths) / sizeof(default_paths[0]);
+    if (argc > 1) {
+        paths = (const char **)(argv + 1);
+        path_count = argc - 1;
+    }
+
+    // the caller and a worker on every other core
+    job_system_init(0);
+    printf("%-30s %-5s %-7s %8s %12s %12s\n", "image", "fmt", "quality", "PSNR", "MPix/s (1)", "MPix/s (N)");
+    for (int p = 0; p < path_count; p++) {
+        int width, height, n;
+        uint8_t *rgba = stbi_load(paths[p], &width, &height, &n, 4);
+        if (rgba == NULL) {
+            printf("Failed to load texture: %s\n", paths[p]);
+            continue;
+        }
+        double megapixels = (double)width * height / 1e6;
+        uint8_t *decoded = (uint8_t *)malloc((size_t)width * height * 4);
+
+        for (int f = 0; f < BC_FORMAT_COUNT; f++) {
+            Bc_Format format = (Bc_Format)f;
+            uint8_t *blocks = (uint8_t *)malloc((size_t)bc_compressed_size(format, width, height));
+            for (int q = 0; q < BC_QUALITY_COUNT; q++) {
+                Bc_Quality quality = (Bc_Quality)q;
+
+                double start = now_seconds();
+                bc_compress(format, rgba, width, height, blocks, quality, 1);
+                double single = now_seconds() - start;
+
+                start = now_seconds();
+                bc_compress(format, rgba, width, height, blocks, quality, 0);
+                double parallel = now_seconds() - start;
+
+                bc_decompress(format, blocks, width, height, decoded);
+                printf("%-30s %-5s %-7s %8.2f %12.2f %12.2f\n", paths[p], bc_format_name(format), bc_quality_name(quality),
+                       psnr(rgba, decoded, width * height, format_channels(format)), megapixels / single, megapixels / parallel);
+            }
+            free(blocks);
+        }
+
+        free(decoded);
+        stbi_image_free(rgba);
+    }
+    printf("(N = %d threads)\n", job_thread_count() + 1);
+    job_system_shutdown();
+    return 0;
+}
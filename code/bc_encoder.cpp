@@ -0,0 +1,664 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "bc_encoder.h"
+#include "job_system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Pixels of one block, structure of arrays: channel * 16 + pixel
+struct Block_Pixels {
+    float c[4 * 16];
+};
+
+static const int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+const char *bc_format_name(Bc_Format format) {
+    switch (format) {
+    case BC_FORMAT_BC1: return "BC1";
+    case BC_FORMAT_BC4: return "BC4";
+    case BC_FORMAT_BC5: return "BC5";
+    case BC_FORMAT_BC7: return "BC7";
+    default: return "unknown";
+    }
+}
+
+const char *bc_quality_name(Bc_Quality quality) {
+    switch (quality) {
+    case BC_QUALITY_FAST: return "fast";
+    case BC_QUALITY_NORMAL: return "normal";
+    case BC_QUALITY_HIGH: return "high";
+    default: return "unknown";
+    }
+}
+
+int bc_block_bytes(Bc_Format format) {
+    return (format == BC_FORMAT_BC1 || format == BC_FORMAT_BC4) ? 8 : 16;
+}
+
+int64_t bc_compressed_size(Bc_Format format, int width, int height) {
+    return (int64_t)((width + 3) / 4) * ((height + 3) / 4) * bc_block_bytes(format);
+}
+
+GLenum bc_gl_internal_format(Bc_Format format) {
+    switch (format) {
+    case BC_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BC_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+    case BC_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+    case BC_FORMAT_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return 0;
+    }
+}
+
+int bc_block_bytes_for_gl_format(GLenum internal_format) {
+    switch (internal_format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+static int clamp_int(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static int round_to_int(float v) {
+    return (int)floorf(v + 0.5f);
+}
+
+// Squared error of every pixel against every palette entry, keeping the
+// closest entry. Returns the total error of the block.
+static float select_indices(const Block_Pixels *pixels, int channels, const float *palette, int entries, uint8_t *indices) {
+#ifdef BC_SSE2
+    __m128 total = _mm_setzero_ps();
+    for (int group = 0; group < 4; group++) {
+        __m128 p[4];
+        for (int c = 0; c < channels; c++) p[c] = _mm_loadu_ps(pixels->c + c * 16 + group * 4);
+
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i best_index = _mm_setzero_si128();
+        for (int e = 0; e < entries; e++) {
+            __m128 d = _mm_setzero_ps();
+            for (int c = 0; c < channels; c++) {
+                __m128 diff = _mm_sub_ps(p[c], _mm_set1_ps(palette[e * 4 + c]));
+                d = _mm_add_ps(d, _mm_mul_ps(diff, diff));
+            }
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best = _mm_min_ps(d, best);
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(e)), _mm_andnot_si128(closer, best_index));
+        }
+        total = _mm_add_ps(total, best);
+
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, best_index);
+        for (int i = 0; i < 4; i++) indices[group * 4 + i] = (uint8_t)lanes[i];
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, total);
+    return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        int best_index = 0;
+        for (int e = 0; e < entries; e++) {
+            float d = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                float diff = pixels->c[c * 16 + i] - palette[e * 4 + c];
+                d += diff * diff;
+            }
+            if (d < best) {
+                best = d;
+                best_index = e;
+            }
+        }
+        indices[i] = (uint8_t)best_index;
+        total += best;
+    }
+    return total;
+#endif
+}
+
+static void load_block(const uint8_t *rgba, Block_Pixels *out) {
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) out->c[c * 16 + i] = (float)rgba[i * 4 + c];
+    }
+}
+
+// Endpoints along the principal axis (or the bounding box diagonal for fast)
+static void find_endpoints(const Block_Pixels *pixels, int channels, Bc_Quality quality, float *e0, float *e1) {
+    float mean[4] = {};
+    float lo[4], hi[4];
+    for (int c = 0; c < channels; c++) {
+        lo[c] = 255.0f;
+        hi[c] = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float v = pixels->c[c * 16 + i];
+            mean[c] += v;
+            if (v < lo[c]) lo[c] = v;
+            if (v > hi[c]) hi[c] = v;
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4];
+        for (int c = 0; c < channels; c++) d[c] = pixels->c[c * 16 + i] - mean[c];
+        for (int a = 0; a < channels; a++) {
+            for (int b = a; b < channels; b++) cov[a][b] += d[a] * d[b];
+        }
+    }
+    for (int a = 0; a < channels; a++) {
+        for (int b = 0; b < a; b++) cov[a][b] = cov[b][a];
+    }
+
+    if (quality == BC_QUALITY_FAST) {
+        // bounding box, flipping channels that anti-correlate with the largest one
+        int major = 0;
+        for (int c = 1; c < channels; c++) {
+            if (cov[c][c] > cov[major][major]) major = c;
+        }
+        for (int c = 0; c < channels; c++) {
+            bool flip = cov[major][c] < 0.0f;
+            e0[c] = flip ? lo[c] : hi[c];
+            e1[c] = flip ? hi[c] : lo[c];
+        }
+        return;
+    }
+
+    float axis[4];
+    for (int c = 0; c < channels; c++) axis[c] = hi[c] - lo[c];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) next[a] += cov[a][b] * axis[b];
+        }
+        float len = 0.0f;
+        for (int c = 0; c < channels; c++) len = fmaxf(len, fabsf(next[c]));
+        if (len < 1e-6f) break;
+        for (int c = 0; c < channels; c++) axis[c] = next[c] / len;
+    }
+    float len2 = 0.0f;
+    for (int c = 0; c < channels; c++) len2 += axis[c] * axis[c];
+    if (len2 < 1e-12f) {
+        for (int c = 0; c < channels; c++) e0[c] = e1[c] = mean[c];
+        return;
+    }
+
+    float tmin = 1e30f, tmax = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) t += (pixels->c[c * 16 + i] - mean[c]) * axis[c];
+        t /= len2;
+        tmin = fminf(tmin, t);
+        tmax = fmaxf(tmax, t);
+    }
+    for (int c = 0; c < channels; c++) {
+        e0[c] = fminf(fmaxf(mean[c] + axis[c] * tmax, 0.0f), 255.0f);
+        e1[c] = fminf(fmaxf(mean[c] + axis[c] * tmin, 0.0f), 255.0f);
+    }
+}
+
+// Least squares endpoints for fixed indices, weights in [0, 1] towards e1
+static bool refine_endpoints(const Block_Pixels *pixels, int channels, const uint8_t *indices, const float *weights, float *e0, float *e1) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; c++) {
+            ax[c] += a * pixels->c[c * 16 + i];
+            bx[c] += b * pixels->c[c * 16 + i];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f) return false;
+    float inv = 1.0f / det;
+    for (int c = 0; c < channels; c++) {
+        e0[c] = fminf(fmaxf((ax[c] * bb - bx[c] * ab) * inv, 0.0f), 255.0f);
+        e1[c] = fminf(fmaxf((bx[c] * aa - ax[c] * ab) * inv, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+//
+// BC1
+//
+
+static uint16_t pack_565(const float *c) {
+    int r = clamp_int(round_to_int(c[0] * 31.0f / 255.0f), 0, 31);
+    int g = clamp_int(round_to_int(c[1] * 63.0f / 255.0f), 0, 63);
+    int b = clamp_int(round_to_int(c[2] * 31.0f / 255.0f), 0, 31);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t v, int *out) {
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+static void bc1_palette(uint16_t c0, uint16_t c1, float *palette) {
+    int a[3], b[3];
+    unpack_565(c0, a);
+    unpack_565(c1, b);
+    for (int c = 0; c < 3; c++) {
+        palette[0 * 4 + c] = (float)a[c];
+        palette[1 * 4 + c] = (float)b[c];
+        if (c0 > c1) {
+            palette[2 * 4 + c] = (float)((2 * a[c] + b[c]) / 3);
+            palette[3 * 4 + c] = (float)((a[c] + 2 * b[c]) / 3);
+        } else {
+            palette[2 * 4 + c] = (float)((a[c] + b[c]) / 2);
+            palette[3 * 4 + c] = 0.0f;
+        }
+    }
+}
+
+static float bc1_try(const Block_Pixels *pixels, const float *e0, const float *e1, uint16_t *out_c0, uint16_t *out_c1, uint8_t *indices) {
+    uint16_t c0 = pack_565(e0);
+    uint16_t c1 = pack_565(e1);
+    if (c0 < c1) {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+    float palette[4 * 4];
+    bc1_palette(c0, c1, palette);
+    // equal endpoints select the 3 color mode, where only entry 0 is useful
+    float error = select_indices(pixels, 3, palette, c0 == c1 ? 1 : 4, indices);
+    *out_c0 = c0;
+    *out_c1 = c1;
+    return error;
+}
+
+static void bc1_compress_block(const uint8_t *rgba, uint8_t *out, Bc_Quality quality) {
+    Block_Pixels pixels;
+    load_block(rgba, &pixels);
+
+    float e0[4], e1[4];
+    find_endpoints(&pixels, 3, quality, e0, e1);
+
+    uint16_t c0, c1;
+    uint8_t indices[16];
+    float error = bc1_try(&pixels, e0, e1, &c0, &c1, indices);
+
+    int iterations = quality == BC_QUALITY_HIGH ? 3 : (quality == BC_QUALITY_NORMAL ? 1 : 0);
+    const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    for (int i = 0; i < iterations && c0 != c1; i++) {
+        if (!refine_endpoints(&pixels, 3, indices, weights, e0, e1)) break;
+        uint16_t r0, r1;
+        uint8_t refined[16];
+        float refined_error = bc1_try(&pixels, e0, e1, &r0, &r1, refined);
+        if (refined_error >= error) break;
+        error = refined_error;
+        c0 = r0;
+        c1 = r1;
+        memcpy(indices, refined, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) bits |= (uint32_t)indices[i] << (2 * i);
+    memcpy(out, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &bits, 4);
+}
+
+static void bc1_decompress_block(const uint8_t *block, uint8_t *out) {
+    uint16_t c0, c1;
+    uint32_t bits;
+    memcpy(&c0, block, 2);
+    memcpy(&c1, block + 2, 2);
+    memcpy(&bits, block + 4, 4);
+    float palette[4 * 4];
+    bc1_palette(c0, c1, palette);
+    for (int i = 0; i < 16; i++) {
+        int index = (bits >> (2 * i)) & 3;
+        for (int c = 0; c < 3; c++) out[i * 4 + c] = (uint8_t)palette[index * 4 + c];
+        out[i * 4 + 3] = (c0 <= c1 && index == 3) ? 0 : 255;
+    }
+}
+
+//
+// BC4, BC5 is two of these
+//
+
+static void bc4_palette(int e0, int e1, float *palette) {
+    palette[0] = (float)e0;
+    palette[4] = (float)e1;
+    if (e0 > e1) {
+        for (int i = 2; i < 8; i++) palette[i * 4] = (float)(((8 - i) * e0 + (i - 1) * e1) / 7);
+    } else {
+        for (int i = 2; i < 6; i++) palette[i * 4] = (float)(((6 - i) * e0 + (i - 1) * e1) / 5);
+        palette[6 * 4] = 0.0f;
+        palette[7 * 4] = 255.0f;
+    }
+}
+
+static void bc4_compress_channel(const uint8_t *rgba, int channel, uint8_t *out, Bc_Quality quality) {
+    Block_Pixels pixels;
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        int v = rgba[i * 4 + channel];
+        pixels.c[i] = (float)v;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+
+    float palette[8 * 4];
+    uint8_t indices[16] = {};
+    int best_e0 = hi, best_e1 = lo;
+    if (hi > lo) {
+        // shrinking the range a little often lowers the error of the interior values
+        int search = quality == BC_QUALITY_HIGH ? 3 : (quality == BC_QUALITY_NORMAL ? 1 : 0);
+        float best_error = 1e30f;
+        for (int d0 = 0; d0 <= search; d0++) {
+            for (int d1 = 0; d1 <= search; d1++) {
+                int e0 = hi - d0;
+                int e1 = lo + d1;
+                if (e0 <= e1) continue;
+                uint8_t trial[16];
+                bc4_palette(e0, e1, palette);
+                float error = select_indices(&pixels, 1, palette, 8, trial);
+                if (error < best_error) {
+                    best_error = error;
+                    best_e0 = e0;
+                    best_e1 = e1;
+                    memcpy(indices, trial, sizeof(indices));
+                }
+            }
+        }
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) bits |= (uint64_t)indices[i] << (3 * i);
+    out[0] = (uint8_t)best_e0;
+    out[1] = (uint8_t)best_e1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+static void bc4_decompress_channel(const uint8_t *block, int channel, uint8_t *out) {
+    float palette[8 * 4];
+    bc4_palette(block[0], block[1], palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) bits |= (uint64_t)block[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++) {
+        int index = (int)((bits >> (3 * i)) & 7);
+        out[i * 4 + channel] = (uint8_t)palette[index * 4];
+    }
+}
+
+//
+// BC7, mode 6 only: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4 bit indices
+//
+
+static void bc7_palette(const int *q0, const int *q1, float *palette) {
+    for (int i = 0; i < 16; i++) {
+        int w = BC7_WEIGHTS4[i];
+        for (int c = 0; c < 4; c++) palette[i * 4 + c] = (float)(((64 - w) * q0[c] + w * q1[c] + 32) >> 6);
+    }
+}
+
+static void bc7_quantize(const float *e, int pbit, int *out_q7, int *out_value) {
+    for (int c = 0; c < 4; c++) {
+        int q = clamp_int(round_to_int((e[c] - (float)pbit) / 2.0f), 0, 127);
+        out_q7[c] = q;
+        out_value[c] = (q << 1) | pbit;
+    }
+}
+
+struct Bc7_Mode6 {
+    int q0[4], q1[4]; // 7 bit endpoints
+    int p0, p1;
+    uint8_t indices[16];
+    float error;
+};
+
+static void bc7_try(const Block_Pixels *pixels, const float *e0, const float *e1, bool search_pbits, Bc7_Mode6 *best) {
+    best->error = 1e30f;
+    int combinations = search_pbits ? 4 : 1;
+    for (int p = 0; p < combinations; p++) {
+        int p0 = p & 1;
+        int p1 = p >> 1;
+        if (!search_pbits) {
+            // p-bit that best matches the average low bit of each endpoint
+            float s0 = 0.0f, s1 = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                s0 += e0[c] - 2.0f * floorf(e0[c] / 2.0f);
+                s1 += e1[c] - 2.0f * floorf(e1[c] / 2.0f);
+            }
+            p0 = s0 >= 2.0f;
+            p1 = s1 >= 2.0f;
+        }
+
+        Bc7_Mode6 trial;
+        int v0[4], v1[4];
+        bc7_quantize(e0, p0, trial.q0, v0);
+        bc7_quantize(e1, p1, trial.q1, v1);
+        trial.p0 = p0;
+        trial.p1 = p1;
+        float palette[16 * 4];
+        bc7_palette(v0, v1, palette);
+        trial.error = select_indices(pixels, 4, palette, 16, trial.indices);
+        if (trial.error < best->error) *best = trial;
+    }
+}
+
+static void put_bits(uint8_t *block, int *pos, uint32_t value, int count) {
+    for (int i = 0; i < count; i++, (*pos)++) {
+        if (value & (1u << i)) block[*pos >> 3] |= (uint8_t)(1u << (*pos & 7));
+    }
+}
+
+static uint32_t get_bits(const uint8_t *block, int *pos, int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++, (*pos)++) {
+        value |= (uint32_t)((block[*pos >> 3] >> (*pos & 7)) & 1) << i;
+    }
+    return value;
+}
+
+static void bc7_compress_block(const uint8_t *rgba, uint8_t *out, Bc_Quality quality) {
+    Block_Pixels pixels;
+    load_block(rgba, &pixels);
+
+    float e0[4], e1[4];
+    find_endpoints(&pixels, 4, quality, e0, e1);
+
+    Bc7_Mode6 best;
+    bool search_pbits = quality != BC_QUALITY_FAST;
+    bc7_try(&pixels, e0, e1, search_pbits, &best);
+
+    int iterations = quality == BC_QUALITY_HIGH ? 2 : 0;
+    float weights[16];
+    for (int i = 0; i < 16; i++) weights[i] = (float)BC7_WEIGHTS4[i] / 64.0f;
+    for (int i = 0; i < iterations; i++) {
+        if (!refine_endpoints(&pixels, 4, best.indices, weights, e0, e1)) break;
+        Bc7_Mode6 refined;
+        bc7_try(&pixels, e0, e1, true, &refined);
+        if (refined.error >= best.error) break;
+        best = refined;
+    }
+
+    // the anchor index is stored with its top bit implied zero
+    if (best.indices[0] & 8) {
+        for (int c = 0; c < 4; c++) {
+            int t = best.q0[c];
+            best.q0[c] = best.q1[c];
+            best.q1[c] = t;
+        }
+        int t = best.p0;
+        best.p0 = best.p1;
+        best.p1 = t;
+        for (int i = 0; i < 16; i++) best.indices[i] = (uint8_t)(15 - best.indices[i]);
+    }
+
+    memset(out, 0, 16);
+    int pos = 0;
+    put_bits(out, &pos, 1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        put_bits(out, &pos, best.q0[c], 7);
+        put_bits(out, &pos, best.q1[c], 7);
+    }
+    put_bits(out, &pos, best.p0, 1);
+    put_bits(out, &pos, best.p1, 1);
+    put_bits(out, &pos, best.indices[0], 3);
+    for (int i = 1; i < 16; i++) put_bits(out, &pos, best.indices[i], 4);
+    assert(pos == 128);
+}
+
+static void bc7_decompress_block(const uint8_t *block, uint8_t *out) {
+    int pos = 0;
+    if (get_bits(block, &pos, 7) != (1u << 6)) {
+        // not mode 6, the encoder never writes other modes
+        for (int i = 0; i < 16; i++) {
+            out[i * 4 + 0] = 255;
+            out[i * 4 + 1] = 0;
+            out[i * 4 + 2] = 255;
+            out[i * 4 + 3] = 255;
+        }
+        return;
+    }
+    int q0[4], q1[4];
+    for (int c = 0; c < 4; c++) {
+        q0[c] = (int)get_bits(block, &pos, 7);
+        q1[c] = (int)get_bits(block, &pos, 7);
+    }
+    int p0 = (int)get_bits(block, &pos, 1);
+    int p1 = (int)get_bits(block, &pos, 1);
+    for (int c = 0; c < 4; c++) {
+        q0[c] = (q0[c] << 1) | p0;
+        q1[c] = (q1[c] << 1) | p1;
+    }
+    float palette[16 * 4];
+    bc7_palette(q0, q1, palette);
+    for (int i = 0; i < 16; i++) {
+        int index = (int)get_bits(block, &pos, i == 0 ? 3 : 4);
+        for (int c = 0; c < 4; c++) out[i * 4 + c] = (uint8_t)palette[index * 4 + c];
+    }
+}
+
+void bc_compress_block(Bc_Format format, const uint8_t *rgba, uint8_t *out_block, Bc_Quality quality) {
+    switch (format) {
+    case BC_FORMAT_BC1:
+        bc1_compress_block(rgba, out_block, quality);
+        break;
+    case BC_FORMAT_BC4:
+        bc4_compress_channel(rgba, 0, out_block, quality);
+        break;
+    case BC_FORMAT_BC5:
+        bc4_compress_channel(rgba, 0, out_block, quality);
+        bc4_compress_channel(rgba, 1, out_block + 8, quality);
+        break;
+    case BC_FORMAT_BC7:
+        bc7_compress_block(rgba, out_block, quality);
+        break;
+    default:
+        assert(0);
+    }
+}
+
+void bc_decompress_block(Bc_Format format, const uint8_t *block, uint8_t *out_rgba) {
+    switch (format) {
+    case BC_FORMAT_BC1:
+        bc1_decompress_block(block, out_rgba);
+        break;
+    case BC_FORMAT_BC4:
+        for (int i = 0; i < 16; i++) {
+            out_rgba[i * 4 + 1] = out_rgba[i * 4 + 2] = 0;
+            out_rgba[i * 4 + 3] = 255;
+        }
+        bc4_decompress_channel(block, 0, out_rgba);
+        break;
+    case BC_FORMAT_BC5:
+        for (int i = 0; i < 16; i++) {
+            out_rgba[i * 4 + 2] = 0;
+            out_rgba[i * 4 + 3] = 255;
+        }
+        bc4_decompress_channel(block, 0, out_rgba);
+        bc4_decompress_channel(block + 8, 1, out_rgba);
+        break;
+    case BC_FORMAT_BC7:
+        bc7_decompress_block(block, out_rgba);
+        break;
+    default:
+        assert(0);
+    }
+}
+
+static void compress_rows(Bc_Format format, const uint8_t *rgba, int width, int height, uint8_t *out,
+                          Bc_Quality quality, int first_row, int end_row) {
+    int blocks_x = (width + 3) / 4;
+    int block_bytes = bc_block_bytes(format);
+    uint8_t block[16 * 4];
+    for (int by = first_row; by < end_row; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            for (int y = 0; y < 4; y++) {
+                int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+                for (int x = 0; x < 4; x++) {
+                    int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+            bc_compress_block(format, block, out + ((size_t)by * blocks_x + bx) * block_bytes, quality);
+        }
+    }
+}
+
+struct Bc_Compress_Job {
+    Bc_Format format;
+    const uint8_t *rgba;
+    int width;
+    int height;
+    uint8_t *out;
+    Bc_Quality quality;
+};
+
+static void compress_rows_job(void *data, int first_row, int end_row) {
+    Bc_Compress_Job *job = (Bc_Compress_Job *)data;
+    compress_rows(job->format, job->rgba, job->width, job->height, job->out, job->quality, first_row, end_row);
+}
+
+void bc_compress(Bc_Format format, const uint8_t *rgba, int width, int height, uint8_t *out, Bc_Quality quality, int thread_count) {
+    int blocks_y = (height + 3) / 4;
+    if (thread_count == 1) {
+        compress_rows(format, rgba, width, height, out, quality, 0, blocks_y);
+        return;
+    }
+    Bc_Compress_Job job = {format, rgba, width, height, out, quality};
+    job_parallel_for(blocks_y, 1, compress_rows_job, &job);
+}
+
+void bc_decompress(Bc_Format format, const uint8_t *blocks, int width, int height, uint8_t *out_rgba) {
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+    int block_bytes = bc_block_bytes(format);
+    uint8_t block[16 * 4];
+    for (int by = 0; by < blocks_y; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            bc_decompress_block(format, blocks + ((size_t)by * blocks_x + bx) * block_bytes, block);
+            for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    memcpy(out_rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+
+// Block compression encoder for material textures. Inputs are always RGBA8;
+// BC4 reads red, BC5 reads red and green.
+enum Bc_Format {
+    BC_FORMAT_BC1, // RGB, 4 bpp
+    BC_FORMAT_BC4, // R, 4 bpp
+    BC_FORMAT_BC5, // RG, 8 bpp
+    BC_FORMAT_BC7, // RGBA, 8 bpp (mode 6)
+    BC_FORMAT_COUNT
+};
+
+// Speed/quality knob: bounding box endpoints, PCA endpoints, PCA plus
+// least-squares endpoint refinement.
+enum Bc_Quality {
+    BC_QUALITY_FAST,
+    BC_QUALITY_NORMAL,
+    BC_QUALITY_HIGH,
+    BC_QUALITY_COUNT
+};
+
+// GL_EXT_texture_compression_s3tc is not part of core GL
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+const char *bc_format_name(Bc_Format format);
+const char *bc_quality_name(Bc_Quality quality);
+int bc_block_bytes(Bc_Format format);
+int64_t bc_compressed_size(Bc_Format format, int width, int height);
+GLenum bc_gl_internal_format(Bc_Format format);
+// Bytes per 4x4 block of a compressed GL internal format, 0 if it is not one
+int bc_block_bytes_for_gl_format(GLenum internal_format);
+
+void bc_compress_block(Bc_Format format, const uint8_t *rgba, uint8_t *out_block, Bc_Quality quality);
+void bc_decompress_block(Bc_Format format, const uint8_t *block, uint8_t *out_rgba);
+
+// With thread_count 1 runs on the calling thread, otherwise block rows are
+// a parallel for on the job system.
+// Partial edge blocks are padded by clamping.
+void bc_compress(Bc_Format format, const uint8_t *rgba, int width, int height, uint8_t *out, Bc_Quality quality, int thread_count);
+void bc_decompress(Bc_Format format, const uint8_t *blocks, int width, int height, uint8_t *out_rgba);
+
+#endif // BC_ENCODER_H
@@ -5,15 +5,17 @@
 
 typedef uint8_t  u8;
 typedef uint16_t u16;
-typedef uint16_t u32;
-typedef uint16_t u64;
+typedef uint32_t u32;
+typedef uint64_t u64;
 
 typedef int8_t  s8;
 typedef int16_t s16;
-typedef int16_t s32;
-typedef int16_t s64;
+typedef int32_t s32;
+typedef int64_t s64;
 
 typedef float f32;
 typedef double f64;
 
+static_assert(sizeof(u32) == 4 && sizeof(u64) == 8 && sizeof(s32) == 4 && sizeof(s64) == 8, "sized integer typedefs");
+
 #endif // COMMON_H
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "geometry_pool.h"
+
+void range_allocator_init(Range_Allocator *allocator, int64_t size) {
+    *allocator = {};
+    allocator->size = size;
+    allocator->range_capacity = 16;
+    allocator->ranges = (Free_Range *)malloc(allocator->range_capacity * sizeof(Free_Range));
+    allocator->ranges[0] = {0, size};
+    allocator->range_count = 1;
+}
+
+void range_allocator_release(Range_Allocator *allocator) {
+    free(allocator->ranges);
+    *allocator = {};
+}
+
+static void range_insert(Range_Allocator *allocator, int index, Free_Range range) {
+    if (allocator->range_count == allocator->range_capacity) {
+        allocator->range_capacity *= 2;
+        allocator->ranges = (Free_Range *)realloc(allocator->ranges, allocator->range_capacity * sizeof(Free_Range));
+    }
+    memmove(allocator->ranges + index + 1, allocator->ranges + index, (allocator->range_count - index) * sizeof(Free_Range));
+    allocator->ranges[index] = range;
+    allocator->range_count++;
+}
+
+static void range_remove(Range_Allocator *allocator, int index) {
+    memmove(allocator->ranges + index, allocator->ranges + index + 1, (allocator->range_count - index - 1) * sizeof(Free_Range));
+    allocator->range_count--;
+}
+
+bool range_alloc(Range_Allocator *allocator, int64_t size, int64_t alignment, int64_t *out_offset) {
+    assert(size > 0 && alignment > 0);
+    for (int i = 0; i < allocator->range_count; i++) {
+        Free_Range range = allocator->ranges[i];
+        int64_t aligned = (range.offset + alignment - 1) / alignment * alignment;
+        int64_t padding = aligned - range.offset;
+        if (range.size < padding + size) continue;
+
+        int64_t tail = range.size - padding - size;
+        if (padding > 0 && tail > 0) {
+            allocator->ranges[i].size = padding;
+            range_insert(allocator, i + 1, {aligned + size, tail});
+        } else if (padding > 0) {
+            allocator->ranges[i].size = padding;
+        } else if (tail > 0) {
+            allocator->ranges[i] = {aligned + size, tail};
+        } else {
+            range_remove(allocator, i);
+        }
+
+        allocator->used += size;
+        *out_offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void range_free(Range_Allocator *allocator, int64_t offset, int64_t size) {
+    int index = 0;
+    while (index < allocator->range_count && allocator->ranges[index].offset < offset) index++;
+    assert(index == allocator->range_count || offset + size <= allocator->ranges[index].offset);
+    allocator->used -= size;
+
+    bool merge_prev = index > 0 && allocator->ranges[index - 1].offset + allocator->ranges[index - 1].size == offset;
+    bool merge_next = index < allocator->range_count && offset + size == allocator->ranges[index].offset;
+    if (merge_prev && merge_next) {
+        allocator->ranges[index - 1].size += size + allocator->ranges[index].size;
+        range_remove(allocator, index);
+    } else if (merge_prev) {
+        allocator->ranges[index - 1].size += size;
+    } else if (merge_next) {
+        allocator->ranges[index].offset = offset;
+        allocator->ranges[index].size += size;
+    } else {
+        range_insert(allocator, index, {offset, size});
+    }
+}
+
+void geometry_pool_init(Geometry_Pool *pool, int64_t vertex_capacity, int64_t index_capacity) {
+    *pool = {};
+    glCreateBuffers(1, &pool->vertex_buffer);
+    glNamedBufferStorage(pool->vertex_buffer, vertex_capacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &pool->index_buffer);
+    glNamedBufferStorage(pool->index_buffer, index_capacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+    range_allocator_init(&pool->vertex_ranges, vertex_capacity);
+    range_allocator_init(&pool->index_ranges, index_capacity);
+}
+
+void geometry_pool_release(Geometry_Pool *pool) {
+    glDeleteVertexArrays(pool->layout_count, pool->vaos);
+    glDeleteBuffers(1, &pool->vertex_buffer);
+    glDeleteBuffers(1, &pool->index_buffer);
+    range_allocator_release(&pool->vertex_ranges);
+    range_allocator_release(&pool->index_ranges);
+    *pool = {};
+}
+
+static bool vertex_layout_equal(Vertex_Layout *a, Vertex_Layout *b) {
+    if (a->stride != b->stride || a->attrib_count != b->attrib_count) return false;
+    for (int i = 0; i < a->attrib_count; i++) {
+        Vertex_Attrib *x = &a->attribs[i];
+        Vertex_Attrib *y = &b->attribs[i];
+        if (x->size != y->size || x->type != y->type || x->normalized != y->normalized || x->offset != y->offset) return false;
+    }
+    return true;
+}
+
+static GLuint geometry_pool_vao(Geometry_Pool *pool, Vertex_Layout *layout) {
+    for (int i = 0; i < pool->layout_count; i++) {
+        if (vertex_layout_equal(&pool->layouts[i], layout)) return pool->vaos[i];
+    }
+    if (pool->layout_count == GEOMETRY_POOL_MAX_LAYOUTS) {
+        return 0;
+    }
+
+    GLuint vao;
+    glCreateVertexArrays(1, &vao);
+    for (int i = 0; i < layout->attrib_count; i++) {
+        Vertex_Attrib *attrib = &layout->attribs[i];
+        glEnableVertexArrayAttrib(vao, i);
+        glVertexArrayAttribFormat(vao, i, attrib->size, attrib->type, attrib->normalized, attrib->offset);
+        glVertexArrayAttribBinding(vao, i, 0);
+    }
+    glVertexArrayVertexBuffer(vao, 0, pool->vertex_buffer, 0, layout->stride);
+    glVertexArrayElementBuffer(vao, pool->index_buffer);
+
+    pool->layouts[pool->layout_count] = *layout;
+    pool->vaos[pool->layout_count] = vao;
+    pool->layout_count++;
+    return vao;
+}
+
+bool geometry_pool_add(Geometry_Pool *pool, Vertex_Layout *layout, const void *vertices, int vertex_count,
+                       const void *indices, int index_count, int index_size, Pool_Mesh *out_mesh) {
+    Pool_Mesh mesh{};
+    mesh.vao = geometry_pool_vao(pool, layout);
+    if (!mesh.vao) {
+        printf("Geometry pool: too many vertex layouts\n");
+        return false;
+    }
+
+    // vertex ranges are aligned to the stride so the offset is a whole base vertex
+    mesh.vertex_bytes = (int64_t)vertex_count * layout->stride;
+    if (!range_alloc(&pool->vertex_ranges, mesh.vertex_bytes, layout->stride, &mesh.vertex_offset)) {
+        printf("Geometry pool: out of vertex memory (%lld bytes requested)\n", (long long)mesh.vertex_bytes);
+        return false;
+    }
+    mesh.index_bytes = (int64_t)index_count * index_size;
+    if (!range_alloc(&pool->index_ranges, mesh.index_bytes, 4, &mesh.index_offset)) {
+        printf("Geometry pool: out of index memory (%lld bytes requested)\n", (long long)mesh.index_bytes);
+        range_free(&pool->vertex_ranges, mesh.vertex_offset, mesh.vertex_bytes);
+        return false;
+    }
+
+    mesh.base_vertex = (int)(mesh.vertex_offset / layout->stride);
+    mesh.index_count = index_count;
+    mesh.index_type = index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    glNamedBufferSubData(pool->vertex_buffer, mesh.vertex_offset, mesh.vertex_bytes, vertices);
+    glNamedBufferSubData(pool->index_buffer, mesh.index_offset, mesh.index_bytes, indices);
+
+    *out_mesh = mesh;
+    return true;
+}
+
+void geometry_pool_remove(Geometry_Pool *pool, Pool_Mesh *mesh) {
+    range_free(&pool->vertex_ranges, mesh->vertex_offset, mesh->vertex_bytes);
+    range_free(&pool->index_ranges, mesh->index_offset, mesh->index_bytes);
+    *mesh = {};
+}
+
+void geometry_pool_draw(Pool_Mesh *mesh) {
+    glBindVertexArray(mesh->vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, mesh->index_count, mesh->index_type, (void *)(intptr_t)mesh->index_offset, mesh->base_vertex);
+}
+
+void geometry_pool_draw_instanced(Pool_Mesh *mesh, int instance_count) {
+    glBindVertexArray(mesh->vao);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh->index_count, mesh->index_type, (void *)(intptr_t)mesh->index_offset,
+                                      instance_count, mesh->base_vertex);
+}
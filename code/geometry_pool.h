@@ -0,0 +1,66 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+
+#include "vertex_format.h"
+
+#define GEOMETRY_POOL_MAX_LAYOUTS 8
+
+struct Free_Range {
+    int64_t offset;
+    int64_t size;
+};
+
+// First-fit free list over [0, size), kept sorted by offset and coalesced on free.
+struct Range_Allocator {
+    int64_t size;
+    int64_t used;
+    Free_Range *ranges;
+    int range_count;
+    int range_capacity;
+};
+
+void range_allocator_init(Range_Allocator *allocator, int64_t size);
+void range_allocator_release(Range_Allocator *allocator);
+// Alignment does not have to be a power of two, vertex ranges are aligned to the stride.
+bool range_alloc(Range_Allocator *allocator, int64_t size, int64_t alignment, int64_t *out_offset);
+void range_free(Range_Allocator *allocator, int64_t offset, int64_t size);
+
+// A mesh living in the shared buffers. Draw with glDrawElementsBaseVertex.
+struct Pool_Mesh {
+    GLuint vao;
+    int base_vertex;
+    int64_t vertex_offset;
+    int64_t vertex_bytes;
+    int64_t index_offset;
+    int64_t index_bytes;
+    int index_count;
+    GLenum index_type;
+};
+
+// Large immutable vertex and index buffers shared by every mesh, with one VAO
+// per distinct vertex layout.
+struct Geometry_Pool {
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    Range_Allocator vertex_ranges;
+    Range_Allocator index_ranges;
+
+    int layout_count;
+    Vertex_Layout layouts[GEOMETRY_POOL_MAX_LAYOUTS];
+    GLuint vaos[GEOMETRY_POOL_MAX_LAYOUTS];
+};
+
+void geometry_pool_init(Geometry_Pool *pool, int64_t vertex_capacity, int64_t index_capacity);
+void geometry_pool_release(Geometry_Pool *pool);
+// Returns false if the pool is out of space or layouts
+bool geometry_pool_add(Geometry_Pool *pool, Vertex_Layout *layout, const void *vertices, int vertex_count,
+                       const void *indices, int index_count, int index_size, Pool_Mesh *out_mesh);
+void geometry_pool_remove(Geometry_Pool *pool, Pool_Mesh *mesh);
+void geometry_pool_draw(Pool_Mesh *mesh);
+// Shaders tell instances apart by gl_InstanceID
+void geometry_pool_draw_instanced(Pool_Mesh *mesh, int instance_count);
+
+#endif // GEOMETRY_POOL_H
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <assert.h>
+
+#ifdef USE_LIBJPEG_TURBO
+#include <jpeglib.h>
+#endif
+
+#include "image_decode.h"
+#include "asset_pack.h"
+#include "memory_arena.h"
+#include "alloc_tracker.h"
+
+static void *image_alloc(size_t size);
+static void *image_realloc(void *pointer, size_t old_size, size_t new_size);
+static void image_release(void *pointer);
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(size) image_alloc(size)
+#define STBI_REALLOC_SIZED(pointer, old_size, new_size) image_realloc(pointer, old_size, new_size)
+#define STBI_FREE(pointer) image_release(pointer)
+#include <stb_image.h>
+
+// Sits in front of every decoded image in the scratch arena
+struct Image_Header {
+    uint64_t size;
+    uint64_t reserved; // keeps the pixels 16 byte aligned
+};
+
+// While set, decoder allocations come from the thread's scratch arena, and
+// frees are no-ops until the decode is compacted. Outside, e.g. stbi_load
+// called directly, they go to the heap.
+static thread_local bool image_decoding;
+
+static void *image_alloc(size_t size) {
+    return image_decoding ? arena_push(memory_thread_scratch(), size) : malloc(size);
+}
+
+static void *image_realloc(void *pointer, size_t old_size, size_t new_size) {
+    return image_decoding ? arena_grow(memory_thread_scratch(), pointer, old_size, new_size) : realloc(pointer, new_size);
+}
+
+static void image_release(void *pointer) {
+    if (pointer && !arena_owns(memory_thread_scratch(), pointer)) free(pointer);
+}
+
+#ifdef USE_LIBJPEG_TURBO
+#ifdef _MSC_VER
+// setjmp is how libjpeg reports errors; nothing here has a destructor
+#pragma warning(disable: 4611)
+#endif
+
+struct Jpeg_Error {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void jpeg_error_exit(j_common_ptr info) {
+    Jpeg_Error *error = (Jpeg_Error *)info->err;
+    longjmp(error->jump, 1);
+}
+
+static void jpeg_output_message(j_common_ptr info) {
+    // warnings about corrupt data are not worth a line each
+}
+
+static bool is_jpeg(const uint8_t *data, int64_t size) {
+    return size > 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+// Returns NULL for anything stb_image should try instead
+static uint8_t *jpeg_load(const uint8_t *data, int64_t size, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip) {
+    jpeg_decompress_struct info;
+    Jpeg_Error error;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = jpeg_error_exit;
+    error.manager.output_message = jpeg_output_message;
+    uint8_t *volatile pixels = NULL;
+    uint8_t **volatile rows = NULL;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        image_release(rows);
+        image_release(pixels);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, data, (unsigned long)size);
+    jpeg_read_header(&info, TRUE);
+    int file_channels = info.num_components;
+    int channels = desired_channels ? desired_channels : file_channels;
+    if (file_channels != 1 && file_channels != 3) {
+        jpeg_destroy_decompress(&info); // CMYK and friends
+        return NULL;
+    }
+    switch (channels) {
+    case 1: info.out_color_space = JCS_GRAYSCALE; break;
+    case 3: info.out_color_space = JCS_RGB; break;
+    case 4: info.out_color_space = JCS_EXT_RGBA; break; // alpha is 255
+    default:
+        jpeg_destroy_decompress(&info);
+        return NULL;
+    }
+
+    jpeg_start_decompress(&info);
+    int width = (int)info.output_width;
+    int height = (int)info.output_height;
+    size_t stride = (size_t)width * channels;
+    pixels = (uint8_t *)image_alloc(stride * height);
+    rows = (uint8_t **)image_alloc(height * sizeof(uint8_t *));
+    if (!pixels || !rows) {
+        jpeg_destroy_decompress(&info);
+        image_release(rows);
+        image_release(pixels);
+        return NULL;
+    }
+    for (int y = 0; y < height; y++) {
+        rows[y] = pixels + stride * (flip ? height - 1 - y : y);
+    }
+    while (info.output_scanline < info.output_height) {
+        jpeg_read_scanlines(&info, rows + info.output_scanline, info.output_height - info.output_scanline);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    image_release(rows);
+
+    *out_width = width;
+    *out_height = height;
+    *out_channels = file_channels;
+    return pixels;
+}
+#endif
+
+static uint8_t *image_decode(const uint8_t *data, int64_t size, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip) {
+#ifdef USE_LIBJPEG_TURBO
+    if (is_jpeg(data, size)) {
+        uint8_t *pixels = jpeg_load(data, size, out_width, out_height, out_channels, desired_channels, flip);
+        if (pixels) return pixels;
+    }
+#endif
+    stbi_set_flip_vertically_on_load_thread(flip);
+    return stbi_load_from_memory(data, (int)size, out_width, out_height, out_channels, desired_channels);
+}
+
+uint8_t *image_load_from_memory(const uint8_t *data, int64_t size, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip) {
+    ALLOC_ZONE("image_decode");
+    Arena *arena = memory_thread_scratch();
+    Arena_Temp before = arena_temp_begin(arena);
+    Image_Header *header = (Image_Header *)arena_push(arena, sizeof(Image_Header));
+    if (!header) return NULL;
+    Arena_Temp decode = arena_temp_begin(arena);
+
+    image_decoding = true;
+    uint8_t *pixels = image_decode(data, size, out_width, out_height, out_channels, desired_channels, flip);
+    image_decoding = false;
+    if (!pixels) {
+        arena_temp_end(before);
+        return NULL;
+    }
+
+    // move the pixels down over the decoder's own buffers and drop those
+    int channels = desired_channels ? desired_channels : *out_channels;
+    header->size = (uint64_t)*out_width * *out_height * channels;
+    uint8_t *start = (uint8_t *)(header + 1);
+    memmove(start, pixels, (size_t)header->size);
+    arena_temp_end(decode);
+    uint8_t *image = (uint8_t *)arena_push(arena, (size_t)header->size);
+    assert(image == start);
+    return image;
+}
+
+uint8_t *image_load(const char *path, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip) {
+    Asset_File file;
+    if (!asset_open(path, &file)) return NULL;
+    uint8_t *pixels = image_load_from_memory(file.data, file.size, out_width, out_height, out_channels, desired_channels, flip);
+    asset_close(&file);
+    return pixels;
+}
+
+void image_free(uint8_t *pixels) {
+    if (!pixels) return;
+    Arena *arena = memory_thread_scratch();
+    assert(arena_owns(arena, pixels) && "image freed on another thread");
+    // only the newest image can go back right away, the rest wait for a temp end
+    Image_Header *header = (Image_Header *)pixels - 1;
+    if (pixels + header->size == arena->base + arena->used) {
+        Arena_Temp temp = {arena, (size_t)((uint8_t *)header - arena->base)};
+        arena_temp_end(temp);
+    }
+}
+
+const char *image_jpeg_decoder_name() {
+#ifdef USE_LIBJPEG_TURBO
+    return "libjpeg-turbo";
+#else
+    return "stb_image";
+#endif
+}
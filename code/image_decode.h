@@ -0,0 +1,27 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <stdint.h>
+
+// Image decoding for the bakers, a drop-in for stbi_load. Built with
+// USE_LIBJPEG_TURBO, baseline and progressive JPEGs decode through
+// libjpeg-turbo, whose IDCT, upsampling and YCbCr to RGB are SIMD. Everything
+// else, and JPEGs it cannot convert, go through stb_image. Decoding is single
+// threaded; callers decode several images at once on the job system.
+
+// desired_channels is 1 to 4, or 0 for the channels in the file. With flip
+// set the first row returned is the bottom of the image.
+//
+// Decoding runs in the calling thread's scratch arena, and the result stays
+// there with the decoder's own buffers dropped. Free it with image_free on
+// the same thread. Freeing the newest image returns its memory at once; the
+// others stay until an arena_temp_end on memory_thread_scratch() taken
+// before the loads, which is how the bakers free theirs.
+uint8_t *image_load(const char *path, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip);
+uint8_t *image_load_from_memory(const uint8_t *data, int64_t size, int *out_width, int *out_height, int *out_channels, int desired_channels, bool flip);
+void image_free(uint8_t *pixels);
+
+// "libjpeg-turbo" or "stb_image"
+const char *image_jpeg_decoder_name();
+
+#endif // IMAGE_DECODE_H
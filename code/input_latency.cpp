@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#include "input_latency.h"
+
+// Step of the input waiting to be shown, 0 for none. The simulation only
+// writes the time while it is 0 and the render thread only reads it while
+// it is not, so the pair needs no lock.
+static std::atomic<uint64_t> latency_pending_step;
+static double latency_pending_time;
+
+// render thread only
+static float latency_samples[INPUT_LATENCY_SAMPLES]; // ms
+static int64_t latency_sample_count;
+
+void input_latency_event(uint64_t step, double time) {
+    if (step == 0 || latency_pending_step.load(std::memory_order_acquire) != 0) return;
+    latency_pending_time = time;
+    latency_pending_step.store(step, std::memory_order_release);
+}
+
+void input_latency_swapped(uint64_t step, double time) {
+    uint64_t pending = latency_pending_step.load(std::memory_order_acquire);
+    if (pending == 0 || pending > step) return;
+    latency_samples[latency_sample_count % INPUT_LATENCY_SAMPLES] = (float)((time - latency_pending_time) * 1000.0);
+    latency_sample_count++;
+    latency_pending_step.store(0, std::memory_order_release);
+}
+
+static int compare_float(const void *a, const void *b) {
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+void input_latency_report() {
+    int count = latency_sample_count < INPUT_LATENCY_SAMPLES ? (int)latency_sample_count : INPUT_LATENCY_SAMPLES;
+    if (count == 0) return;
+    float sorted[INPUT_LATENCY_SAMPLES];
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sorted[i] = latency_samples[i];
+        sum += sorted[i];
+    }
+    qsort(sorted, count, sizeof(float), compare_float);
+    printf("Input to swap over %d inputs: mean %.1f ms, p50 %.1f, p95 %.1f, p99 %.1f, max %.1f\n", count, sum / count,
+           sorted[count / 2], sorted[count * 95 / 100], sorted[count * 99 / 100], sorted[count - 1]);
+}
@@ -0,0 +1,23 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <stdint.h>
+
+// Time from an input event to the swap of the first frame that shows it.
+// The simulation marks the first event it folds into a step; the render
+// thread closes the mark after swapping a frame made from that step or a
+// later one. One input is in flight at a time, so each sample is the oldest
+// input of some frame, the one that waited longest. Times are glfwGetTime
+// seconds taken when the callback ran, as GLFW has no event timestamps.
+
+#define INPUT_LATENCY_SAMPLES 4096
+
+// Simulation thread. Ignored while an earlier input has not been shown.
+void input_latency_event(uint64_t step, double time);
+// Render thread, after the swap of a frame made from step
+void input_latency_swapped(uint64_t step, double time);
+// Mean, percentiles and worst of the last INPUT_LATENCY_SAMPLES inputs. Call
+// once the render thread has stopped.
+void input_latency_report();
+
+#endif // INPUT_LATENCY_H
@@ -0,0 +1,130 @@
+// Reading every file under data/ REPEAT times: one blocking read after
+// another against batches through async_io, on the thread pool and on
+// io_uring where there is one. Best of a few runs. With the files in the
+// page cache this measures the per read overhead and how well reads overlap;
+// drop the cache between runs to see the disk.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "async_io.h"
+#include "platform.h"
+
+#define MAX_FILES 256
+#define REPEAT 16
+#define RUNS 3
+
+struct Bench_File {
+    char path[512];
+    int64_t size;
+};
+
+struct Bench_Files {
+    Bench_File files[MAX_FILES];
+    int count;
+};
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void add_file(const char *path, void *data) {
+    Bench_Files *files = (Bench_Files *)data;
+    if (files->count == MAX_FILES) return;
+    Bench_File *file = &files->files[files->count];
+    snprintf(file->path, sizeof(file->path), "%s", path);
+    file->size = -1;
+    Platform_File_Stream stream;
+    if (platform_stream_open(path, &stream)) {
+        file->size = stream.size;
+        platform_stream_close(&stream);
+        files->count++;
+    }
+}
+
+static double time_blocking(Bench_Files *files, uint8_t **buffers) {
+    double best = 1e9;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        for (int r = 0; r < REPEAT; r++) {
+            for (int i = 0; i < files->count; i++) {
+                Platform_File_Stream stream;
+                if (!platform_stream_open(files->files[i].path, &stream)) continue;
+                platform_stream_read(&stream, buffers[i], files->files[i].size);
+                platform_stream_close(&stream);
+            }
+        }
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static double time_async(Bench_Files *files, uint8_t **buffers, Async_Read *reads, Async_Read **batch) {
+    int count = files->count * REPEAT;
+    double best = 1e9;
+    for (int run = 0; run < RUNS; run++) {
+        for (int r = 0; r < count; r++) {
+            int i = r % files->count;
+            reads[r].path = files->files[i].path;
+            reads[r].offset = 0;
+            reads[r].size = files->files[i].size;
+            reads[r].buffer = buffers[i];
+            batch[r] = &reads[r];
+        }
+        double start = now_seconds();
+        async_io_submit(batch, count);
+        for (int r = 0; r < count; r++) async_io_wait(&reads[r]);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+        for (int r = 0; r < count; r++) {
+            if (reads[r].bytes_read != reads[r].size) printf("Failed to read %s\n", reads[r].path);
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    const char *directory = argc > 1 ? argv[1] : "data";
+    Bench_Files *files = (Bench_Files *)calloc(1, sizeof(Bench_Files));
+    platform_list_files(directory, true, add_file, files);
+    if (files->count == 0) {
+        printf("No files in %s\n", directory);
+        return 1;
+    }
+
+    double megabytes = 0.0;
+    uint8_t *buffers[MAX_FILES];
+    for (int i = 0; i < files->count; i++) {
+        buffers[i] = (uint8_t *)malloc(files->files[i].size > 0 ? (size_t)files->files[i].size : 1);
+        megabytes += (double)files->files[i].size / (1024.0 * 1024.0);
+    }
+    megabytes *= REPEAT;
+    int read_count = files->count * REPEAT;
+    Async_Read *reads = new Async_Read[read_count]();
+    Async_Read **batch = (Async_Read **)malloc(read_count * sizeof(Async_Read *));
+
+    printf("%d files x %d, %.2f MB, queue depth %d\n", files->count, REPEAT, megabytes, ASYNC_IO_QUEUE_DEPTH);
+    printf("%-28s %10s %10s %12s\n", "reader", "ms", "MB/s", "reads/s");
+    double seconds = time_blocking(files, buffers);
+    printf("%-28s %10.1f %10.1f %12.0f\n", "blocking", seconds * 1000.0, megabytes / seconds, read_count / seconds);
+    for (int use_uring = 0; use_uring < 2; use_uring++) {
+        async_io_init(use_uring != 0);
+        // asking for io_uring without one falls back to the pool, measured already
+        if (!use_uring || strcmp(async_io_backend_name(), "io_uring") == 0) {
+            seconds = time_async(files, buffers, reads, batch);
+            printf("%-28s %10.1f %10.1f %12.0f\n", async_io_backend_name(), seconds * 1000.0, megabytes / seconds, read_count / seconds);
+        } else {
+            printf("%-28s %10s\n", "io_uring", "n/a");
+        }
+        async_io_shutdown();
+    }
+
+    for (int i = 0; i < files->count; i++) free(buffers[i]);
+    delete[] reads;
+    free(batch);
+    free(files);
+    return 0;
+}
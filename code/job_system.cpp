@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include "job_system.h"
+#include "platform.h"
+
+// Jobs a deque holds before job_run runs them in place, a power of two
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_CACHE_LINE 64
+
+struct Job {
+    Job_Proc proc;
+    Job_Range_Proc range_proc; // set for pieces of a parallel for
+    void *data;
+    Job_Counter *counter;
+    int begin;
+    int end;
+    int grain;
+};
+
+// A thief reads a slot before it knows whether it won the job, while the
+// owner may be writing the next one, so every field is atomic. The owner
+// never overwrites the slot at top, so a thief that wins read a whole job.
+struct Job_Slot {
+    std::atomic<Job_Proc> proc;
+    std::atomic<Job_Range_Proc> range_proc;
+    std::atomic<void *> data;
+    std::atomic<Job_Counter *> counter;
+    std::atomic<int> begin;
+    std::atomic<int> end;
+    std::atomic<int> grain;
+};
+
+// Chase-Lev deque, "Correct and Efficient Work-Stealing for Weak Memory
+// Models" (Le et al. 2013), with a fixed ring. The owner pushes and pops at
+// bottom, thieves take from top. bottom sits on its own cache line so the
+// owner does not share one with every thief reading top.
+struct Job_Deque {
+    std::atomic<int64_t> top;
+    uint8_t pad_top[JOB_CACHE_LINE - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom;
+    uint8_t pad_bottom[JOB_CACHE_LINE - sizeof(std::atomic<int64_t>)];
+    Job_Slot slots[JOB_DEQUE_CAPACITY];
+};
+
+static Job_Deque *job_deques; // [0] is the thread that called init
+static int job_deque_count;
+static std::vector<std::thread> job_threads;
+static std::atomic<bool> job_quit;
+// -1 outside the pool. Workers help with anything while they wait, other
+// threads only with their own parallel for.
+static thread_local int job_self = -1;
+static thread_local bool job_self_worker;
+static thread_local uint32_t job_steal_seed;
+
+// Jobs pushed by threads without a deque. The ring doubles when full and
+// never shrinks, so once it has grown to the peak load pushing allocates
+// nothing.
+static std::mutex job_shared_mutex;
+static Job *job_shared_items;
+static int job_shared_capacity;
+static int job_shared_head;
+static std::atomic<int> job_shared_count;
+
+// Idle workers sleep until the epoch moves, and every push moves it
+static std::mutex job_sleep_mutex;
+static std::condition_variable job_sleep_cv;
+static std::atomic<uint32_t> job_epoch;
+static std::atomic<int> job_sleepers;
+
+static void job_slot_store(Job_Slot *slot, const Job *job) {
+    slot->proc.store(job->proc, std::memory_order_relaxed);
+    slot->range_proc.store(job->range_proc, std::memory_order_relaxed);
+    slot->data.store(job->data, std::memory_order_relaxed);
+    slot->counter.store(job->counter, std::memory_order_relaxed);
+    slot->begin.store(job->begin, std::memory_order_relaxed);
+    slot->end.store(job->end, std::memory_order_relaxed);
+    slot->grain.store(job->grain, std::memory_order_relaxed);
+}
+
+static void job_slot_load(Job_Slot *slot, Job *out_job) {
+    out_job->proc = slot->proc.load(std::memory_order_relaxed);
+    out_job->range_proc = slot->range_proc.load(std::memory_order_relaxed);
+    out_job->data = slot->data.load(std::memory_order_relaxed);
+    out_job->counter = slot->counter.load(std::memory_order_relaxed);
+    out_job->begin = slot->begin.load(std::memory_order_relaxed);
+    out_job->end = slot->end.load(std::memory_order_relaxed);
+    out_job->grain = slot->grain.load(std::memory_order_relaxed);
+}
+
+static bool job_deque_push(Job_Deque *deque, const Job *job) {
+    int64_t b = deque->bottom.load(std::memory_order_relaxed);
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    if (b - t >= JOB_DEQUE_CAPACITY) return false;
+    job_slot_store(&deque->slots[b & (JOB_DEQUE_CAPACITY - 1)], job);
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static bool job_deque_pop(Job_Deque *deque, Job *out_job) {
+    int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = deque->top.load(std::memory_order_relaxed);
+    if (t > b) {
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    job_slot_load(&deque->slots[b & (JOB_DEQUE_CAPACITY - 1)], out_job);
+    if (t == b) {
+        // the last one, a thief may be after it too
+        bool won = deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+static bool job_deque_steal(Job_Deque *deque, Job *out_job) {
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque->bottom.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    job_slot_load(&deque->slots[t & (JOB_DEQUE_CAPACITY - 1)], out_job);
+    return deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+static bool job_deque_empty(Job_Deque *deque) {
+    return deque->top.load(std::memory_order_relaxed) >= deque->bottom.load(std::memory_order_relaxed);
+}
+
+static void job_shared_push(const Job *job) {
+    std::lock_guard<std::mutex> lock(job_shared_mutex);
+    int count = job_shared_count.load(std::memory_order_relaxed);
+    if (count == job_shared_capacity) {
+        int capacity = job_shared_capacity ? job_shared_capacity * 2 : 64;
+        Job *items = (Job *)malloc(capacity * sizeof(Job));
+        for (int i = 0; i < count; i++) {
+            items[i] = job_shared_items[(job_shared_head + i) % job_shared_capacity];
+        }
+        free(job_shared_items);
+        job_shared_items = items;
+        job_shared_capacity = capacity;
+        job_shared_head = 0;
+    }
+    job_shared_items[(job_shared_head + count) % job_shared_capacity] = *job;
+    job_shared_count.store(count + 1, std::memory_order_relaxed);
+}
+
+static bool job_shared_pop(Job *out_job) {
+    if (job_shared_count.load(std::memory_order_relaxed) == 0) return false;
+    std::lock_guard<std::mutex> lock(job_shared_mutex);
+    int count = job_shared_count.load(std::memory_order_relaxed);
+    if (count == 0) return false;
+    *out_job = job_shared_items[job_shared_head];
+    job_shared_head = (job_shared_head + 1) % job_shared_capacity;
+    job_shared_count.store(count - 1, std::memory_order_relaxed);
+    return true;
+}
+
+static void job_wake() {
+    job_epoch.fetch_add(1);
+    if (job_sleepers.load() > 0) {
+        // under the mutex so a worker between its last look and its wait
+        // cannot miss it
+        std::lock_guard<std::mutex> lock(job_sleep_mutex);
+        job_sleep_cv.notify_one();
+    }
+}
+
+static void job_execute(Job *job);
+
+static void job_push(const Job *job, bool shared) {
+    if (job->counter) job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+    if (shared || job_self < 0) {
+        job_shared_push(job);
+    } else if (!job_deque_push(&job_deques[job_self], job)) {
+        Job full = *job;
+        job_execute(&full);
+        return;
+    }
+    job_wake();
+}
+
+// Own deque newest first, then the shared queue, then the oldest job of
+// another deque starting from a random one
+static bool job_find(Job *out_job) {
+    if (job_self >= 0 && job_deque_pop(&job_deques[job_self], out_job)) return true;
+    if (!job_self_worker) return false;
+    if (job_shared_pop(out_job)) return true;
+    job_steal_seed = job_steal_seed * 1664525u + 1013904223u;
+    int first = (int)((job_steal_seed >> 16) % (uint32_t)job_deque_count);
+    for (int i = 0; i < job_deque_count; i++) {
+        int victim = (first + i) % job_deque_count;
+        if (victim != job_self && job_deque_steal(&job_deques[victim], out_job)) return true;
+    }
+    return false;
+}
+
+// Nobody is queued behind this thread, so whatever it gives away now goes
+// to a thread with nothing to do
+static bool job_local_empty() {
+    if (job_self >= 0) return job_deque_empty(&job_deques[job_self]);
+    return job_shared_count.load(std::memory_order_relaxed) == 0;
+}
+
+static void job_execute_range(Job *job) {
+    int begin = job->begin;
+    int end = job->end;
+    while (begin < end) {
+        int chunk_end = end - begin > job->grain ? begin + job->grain : end;
+        if (end - chunk_end >= 2 * job->grain && job_local_empty()) {
+            Job half = *job;
+            half.begin = chunk_end + (end - chunk_end) / 2;
+            half.end = end;
+            end = half.begin;
+            job_push(&half, false);
+        }
+        job->range_proc(job->data, begin, chunk_end);
+        begin = chunk_end;
+    }
+}
+
+static void job_execute(Job *job) {
+    if (job->range_proc) {
+        job_execute_range(job);
+    } else {
+        job->proc(job->data);
+    }
+    if (job->counter) job->counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void job_worker(int index, int core) {
+    job_self = index;
+    job_self_worker = true;
+    job_steal_seed = (uint32_t)index * 2654435761u;
+    if (core >= 0) platform_pin_thread(core);
+    while (!job_quit.load(std::memory_order_relaxed)) {
+        uint32_t epoch = job_epoch.load();
+        Job job;
+        if (job_find(&job)) {
+            job_execute(&job);
+            continue;
+        }
+        job_sleepers.fetch_add(1);
+        if (job_epoch.load() == epoch) {
+            std::unique_lock<std::mutex> lock(job_sleep_mutex);
+            job_sleep_cv.wait(lock, [epoch] { return job_epoch.load() != epoch || job_quit.load(); });
+        }
+        job_sleepers.fetch_sub(1);
+    }
+}
+
+void job_system_init(int thread_count) {
+    assert(job_deque_count == 0);
+    int cores = (int)std::thread::hardware_concurrency();
+    if (thread_count <= 0) {
+        thread_count = cores - 1;
+        if (thread_count < 1) thread_count = 1;
+    }
+    job_quit = false;
+    job_deque_count = thread_count + 1;
+    job_deques = new Job_Deque[job_deque_count];
+    for (int i = 0; i < job_deque_count; i++) {
+        job_deques[i].top = 0;
+        job_deques[i].bottom = 0;
+    }
+    job_self = 0;
+    job_self_worker = false;
+    // worker i on core i, leaving core 0 to the main thread. With more
+    // workers than cores the scheduler places them.
+    bool pin = thread_count < cores;
+    for (int i = 1; i <= thread_count; i++) {
+        job_threads.emplace_back(job_worker, i, pin ? i : -1);
+    }
+}
+
+void job_system_shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(job_sleep_mutex);
+        job_quit = true;
+    }
+    job_sleep_cv.notify_all();
+    for (std::thread &thread : job_threads) {
+        thread.join();
+    }
+    job_threads.clear();
+    delete[] job_deques;
+    job_deques = NULL;
+    job_deque_count = 0;
+    job_self = -1;
+    free(job_shared_items);
+    job_shared_items = NULL;
+    job_shared_capacity = 0;
+    job_shared_head = 0;
+    job_shared_count = 0;
+}
+
+int job_thread_count() {
+    return (int)job_threads.size();
+}
+
+void job_run(Job_Proc proc, void *data, Job_Counter *counter) {
+    Job job = {proc, NULL, data, counter, 0, 0, 0};
+    if (job_deque_count == 0) {
+        proc(data);
+        return;
+    }
+    // The main thread's deque holds only pieces of its own parallel for, so
+    // waiting on one never picks up a long job meant for the background
+    job_push(&job, !job_self_worker);
+}
+
+void job_wait(Job_Counter *counter) {
+    while (counter->pending.load(std::memory_order_acquire) > 0) {
+        Job job;
+        if (job_find(&job)) {
+            job_execute(&job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void job_parallel_for(int count, int min_grain, Job_Range_Proc proc, void *data) {
+    if (min_grain < 1) min_grain = 1;
+    if (job_deque_count == 0 || count <= min_grain) {
+        if (count > 0) proc(data, 0, count);
+        return;
+    }
+    Job_Counter counter = {};
+    counter.pending = 1;
+    Job job = {NULL, proc, data, &counter, 0, count, min_grain};
+    job_execute(&job);
+    job_wait(&counter);
+}
@@ -0,0 +1,46 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+
+// Worker threads, one per core besides the main thread and pinned to it,
+// each with its own work-stealing deque. A thread pushes jobs onto its own
+// deque and pops them back newest first, while idle workers steal the oldest
+// from the others, so most pushes and pops touch no shared cache line and
+// take no lock. The thread that calls job_system_init gets a deque too.
+// Other threads, like the io threads, push through a shared queue.
+//
+// Jobs report to an optional counter. job_wait runs other jobs until the
+// counter drops to zero, so a job can wait for jobs it started without
+// tying up its worker:
+//     Job_Counter counter = {};
+//     for (int i = 0; i < count; i++) job_run(load_one, &items[i], &counter);
+//     job_wait(&counter);
+//
+// Without job_system_init, or with no workers, jobs run inside job_run.
+
+typedef void (*Job_Proc)(void *data);
+typedef void (*Job_Range_Proc)(void *data, int begin, int end);
+
+struct Job_Counter {
+    std::atomic<int> pending;
+};
+
+// 0 starts one worker per core less one
+void job_system_init(int thread_count);
+// Drops jobs that have not started and joins the workers. Counters of
+// dropped jobs never reach zero, so nothing may wait on them after this.
+void job_system_shutdown();
+int job_thread_count();
+
+// counter may be NULL for jobs nobody waits on
+void job_run(Job_Proc proc, void *data, Job_Counter *counter);
+void job_wait(Job_Counter *counter);
+
+// Calls proc over [0, count) in ranges of at least min_grain and returns
+// when all are done. The range is halved whenever the thread running it
+// finds its deque emptied by thieves, so it only splits as far as there are
+// idle workers to take the pieces.
+void job_parallel_for(int count, int min_grain, Job_Range_Proc proc, void *data);
+
+#endif // JOB_SYSTEM_H
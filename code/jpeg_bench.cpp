@@ -0,0 +1,148 @@
+// JPEG decode throughput on the skybox faces: stb_image against the
+// image_decode path, one face after another and one thread per face.
+// Files are mapped up front so only decoding is timed, and each result is
+// freed right away on the thread that decoded it. Reports megabytes of
+// JPEG in and megapixels out per second, best of a few runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+
+#include <stb_image.h>
+
+#include "image_decode.h"
+#include "platform.h"
+
+#define MAX_IMAGES 16
+#define RUNS 3
+
+struct Bench_Image {
+    const char *path;
+    Platform_Mapped_File file;
+    int width;
+    int height;
+    uint8_t *reference; // stb_image result, to compare against
+};
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool decode_stb(Bench_Image *image) {
+    int width, height, n;
+    stbi_set_flip_vertically_on_load_thread(0);
+    uint8_t *pixels = stbi_load_from_memory((const uint8_t *)image->file.data, (int)image->file.size, &width, &height, &n, 4);
+    stbi_image_free(pixels);
+    return pixels != NULL;
+}
+
+static bool decode_fast(Bench_Image *image) {
+    int width, height, n;
+    uint8_t *pixels = image_load_from_memory((const uint8_t *)image->file.data, image->file.size, &width, &height, &n, 4, false);
+    image_free(pixels);
+    return pixels != NULL;
+}
+
+// Best time over RUNS to decode every image, sequentially or a thread each
+static double time_decode(Bench_Image *images, int count, bool (*decode)(Bench_Image *), bool threaded) {
+    double best = 1e9;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        if (threaded) {
+            std::thread threads[MAX_IMAGES];
+            for (int i = 0; i < count; i++) {
+                threads[i] = std::thread([images, decode, i]() { decode(&images[i]); });
+            }
+            for (int i = 0; i < count; i++) threads[i].join();
+        } else {
+            for (int i = 0; i < count; i++) decode(&images[i]);
+        }
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    const char *default_paths[] = {
+        "data/skybox/right.jpg",
+        "data/skybox/left.jpg",
+        "data/skybox/top.jpg",
+        "data/skybox/bottom.jpg",
+        "data/skybox/front.jpg",
+        "data/skybox/back.jpg",
+    };
+    const char **paths = default_paths;
+    int path_count = sizeof(default_paths) / sizeof(default_paths[0]);
+    if (argc > 1) {
+        paths = (const char **)(argv + 1);
+        path_count = argc - 1;
+    }
+    if (path_count > MAX_IMAGES) path_count = MAX_IMAGES;
+
+    Bench_Image images[MAX_IMAGES] = {};
+    int count = 0;
+    double megabytes = 0.0;
+    double megapixels = 0.0;
+    for (int p = 0; p < path_count; p++) {
+        Bench_Image *image = &images[count];
+        image->path = paths[p];
+        if (!platform_map_file(paths[p], &image->file)) {
+            printf("Failed to load texture: %s\n", paths[p]);
+            continue;
+        }
+        int n;
+        stbi_set_flip_vertically_on_load_thread(0);
+        image->reference = stbi_load_from_memory((const uint8_t *)image->file.data, (int)image->file.size, &image->width, &image->height, &n, 4);
+        if (!image->reference) {
+            printf("Failed to decode %s\n", paths[p]);
+            platform_unmap_file(&image->file);
+            continue;
+        }
+        megabytes += (double)image->file.size / (1024.0 * 1024.0);
+        megapixels += (double)image->width * image->height / 1e6;
+        count++;
+    }
+    if (count == 0) return 1;
+
+    // the decoders round differently, so report how far apart they are
+    double difference = 0.0;
+    int64_t samples = 0;
+    for (int i = 0; i < count; i++) {
+        int width, height, n;
+        uint8_t *pixels = image_load_from_memory((const uint8_t *)images[i].file.data, images[i].file.size, &width, &height, &n, 4, false);
+        if (!pixels) continue;
+        int64_t size = (int64_t)images[i].width * images[i].height * 4;
+        for (int64_t s = 0; s < size; s++) {
+            difference += abs((int)pixels[s] - (int)images[i].reference[s]);
+        }
+        samples += size;
+        image_free(pixels);
+    }
+
+    printf("%d images, %.2f MB of JPEG, %.2f MPix, fast path: %s\n", count, megabytes, megapixels, image_jpeg_decoder_name());
+    printf("mean absolute difference to stb_image: %.3f\n", difference / (double)samples);
+    printf("%-28s %10s %10s %10s\n", "decoder", "ms", "MB/s", "MPix/s");
+    struct {
+        const char *name;
+        bool (*decode)(Bench_Image *);
+        bool threaded;
+    } cases[] = {
+        {"stb_image", decode_stb, false},
+        {"stb_image, thread per image", decode_stb, true},
+        {image_jpeg_decoder_name(), decode_fast, false},
+        {"fast, thread per image", decode_fast, true},
+    };
+    for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++) {
+        double seconds = time_decode(images, count, cases[c].decode, cases[c].threaded);
+        printf("%-28s %10.1f %10.1f %10.1f\n", cases[c].name, seconds * 1000.0, megabytes / seconds, megapixels / seconds);
+    }
+    printf("(%d cores)\n", (int)std::thread::hardware_concurrency());
+
+    for (int i = 0; i < count; i++) {
+        stbi_image_free(images[i].reference);
+        platform_unmap_file(&images[i].file);
+    }
+    return 0;
+}
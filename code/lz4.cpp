@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "lz4.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_HASH_BITS 12
+// the format wants the last 5 bytes as literals and no match starting in
+// the last 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_FIND_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint32_t lz4_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// The part of a length past the 15 that fits in the token
+static uint8_t *write_length(uint8_t *op, int length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+static uint8_t *write_literals(uint8_t *op, uint8_t *token, const uint8_t *literals, int length) {
+    *token = (uint8_t)((length < 15 ? length : 15) << 4);
+    if (length >= 15) op = write_length(op, length - 15);
+    memcpy(op, literals, length);
+    return op + length;
+}
+
+int lz4_compress_bound(int size) {
+    return size + size / 255 + 16;
+}
+
+int lz4_compress(const uint8_t *src, int size, uint8_t *dst, int capacity) {
+    if (capacity < lz4_compress_bound(size)) return 0;
+    uint8_t *op = dst;
+    int anchor = 0;
+
+    if (size > LZ4_MATCH_FIND_LIMIT) {
+        // positions are checked against the data, so stale entries are harmless
+        int table[1 << LZ4_HASH_BITS] = {};
+        int limit = size - LZ4_MATCH_FIND_LIMIT;
+        int match_limit = size - LZ4_LAST_LITERALS;
+        int ip = 0;
+        while (ip < limit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t h = lz4_hash(sequence);
+            int ref = table[h];
+            table[h] = ip;
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || read32(src + ref) != sequence) {
+                ip++;
+                continue;
+            }
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            int length = LZ4_MIN_MATCH;
+            while (ip + length < match_limit && src[ip + length] == src[ref + length]) length++;
+
+            uint8_t *token = op++;
+            op = write_literals(op, token, src + anchor, ip - anchor);
+            int offset = ip - ref;
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+            int extra = length - LZ4_MIN_MATCH;
+            *token |= (uint8_t)(extra < 15 ? extra : 15);
+            if (extra >= 15) op = write_length(op, extra - 15);
+
+            ip += length;
+            anchor = ip;
+            if (ip < limit) table[lz4_hash(read32(src + ip - 2))] = ip - 2;
+        }
+    }
+
+    uint8_t *token = op++;
+    op = write_literals(op, token, src + anchor, size - anchor);
+    return (int)(op - dst);
+}
+
+// Adds the extra length bytes after a token field of 15
+static bool read_length(const uint8_t **ip, const uint8_t *end, int *length) {
+    uint8_t byte;
+    do {
+        if (*ip >= end) return false;
+        byte = *(*ip)++;
+        *length += byte;
+        if (*length < 0) return false;
+    } while (byte == 255);
+    return true;
+}
+
+int lz4_decompress(const uint8_t *src, int size, uint8_t *dst, int capacity) {
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    uint8_t *op = dst;
+    uint8_t *out_end = dst + capacity;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        int literals = token >> 4;
+        if (literals == 15 && !read_length(&ip, end, &literals)) return -1;
+        if (literals > end - ip || literals > out_end - op) return -1;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) break; // the last sequence has no match
+
+        if (end - ip < 2) return -1;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst) return -1;
+        int length = token & 15;
+        if (length == 15 && !read_length(&ip, end, &length)) return -1;
+        length += LZ4_MIN_MATCH;
+        if (length > out_end - op) return -1;
+
+        const uint8_t *match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // overlapping copy repeats the last offset bytes
+            for (int i = 0; i < length; i++) *op++ = match[i];
+        }
+    }
+    return (int)(op - dst);
+}
@@ -0,0 +1,19 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+// LZ4 block format (no frame, no checksums), enough for the asset pack.
+// Blocks are independent, so callers split large data into chunks and
+// decompress the chunks in parallel.
+
+// Worst case compressed size of size bytes
+int lz4_compress_bound(int size);
+// Greedy single hash compressor. Returns the compressed size, or 0 when
+// capacity is below lz4_compress_bound(size).
+int lz4_compress(const uint8_t *src, int size, uint8_t *dst, int capacity);
+// Returns the decompressed size, or -1 if src is malformed or the output
+// would not fit in capacity. Never reads or writes out of bounds.
+int lz4_decompress(const uint8_t *src, int size, uint8_t *dst, int capacity);
+
+#endif // LZ4_H
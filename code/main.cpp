@@ -4,25 +4,77 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
-
-#include <vector>
+#include <string.h>
+#include <atomic>
+#include <thread>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h> 
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "common.h"
+#include "platform.h"
+#include "memory_arena.h"
+#include "alloc_tracker.h"
+#include "startup.h"
+#include "asset_pack.h"
+#include "mesh.h"
+#include "vertex_format.h"
+#include "geometry_pool.h"
+#include "job_system.h"
+#include "triple_buffer.h"
+#include "input_latency.h"
+#include "texture_loader.h"
+#include "virtual_texture.h"
 
 const int WIDTH = 1600;
 const int HEIGHT = 900;
 
-float delta_time;
+// storage format of the lit cube vertices, decoded in cube_v.glsl
+const Vertex_Format CUBE_VERTEX_FORMAT = VERTEX_FORMAT_PACKED;
+const bool COMPRESS_TEXTURES = true;
+// textures show their small mip levels first and stream the rest in after
+const bool PROGRESSIVE_TEXTURES = true;
+// crate specular mask packed into the diffuse alpha, one texture per material
+const bool PACK_MATERIAL_CHANNELS = true;
+// VRAM for textures, the least recently used lose their top mip levels past it
+const int64_t TEXTURE_BUDGET = 64 * 1024 * 1024;
+// developer builds: heap allocations in the render loop after the warm-up
+// frames are reported, or assert with ASSERT_NO_FRAME_ALLOCATIONS
+const int ALLOCATION_WARM_UP_FRAMES = 120;
+const bool ASSERT_NO_FRAME_ALLOCATIONS = false;
+// the simulation steps on every input event and at least this often
+const double SIMULATION_STEP = 1.0 / 240.0;
+// Latency mode. SWAP_INTERVAL 1 waits for every vblank, 0 never waits and
+// tears, -1 is adaptive vsync: it waits unless the frame is already late,
+// and is 1 where the driver lacks it. MAX_FRAMES_IN_FLIGHT caps the frames
+// the CPU queues ahead of the GPU, each one a frame of added input latency
+// when GPU bound; 1 gives up CPU and GPU overlap for the lowest.
+const int SWAP_INTERVAL = 1;
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+Geometry_Pool geometry_pool;
+
+// std430 layout of Instance in cube_v.glsl
+struct Crate_Instance {
+    glm::mat4 world;
+    uint32_t layer;
+    uint32_t padding[3];
+};
+
+#define CRATE_COUNT 4
+#define CRATE_MATERIAL_COUNT 2
+
+// physical pages of the ground virtual texture, per side
+#define GROUND_CACHE_SIDE 8
+
+// longest wait for a frame fence, so a hung GPU does not hang the loop
+#define FRAME_FENCE_TIMEOUT_NS 100000000ull
+
+Virtual_Texture ground_texture;
 
 glm::vec3 cam_pos = glm::vec3(0.0f, 0.0f, 3.0f);
 glm::vec3 cam_front = glm::vec3(0.0f, 0.0f, -1.0);
@@ -34,16 +86,28 @@ float last_cursor_x, last_cursor_y;
 float yaw = -90.0f;
 float pitch = 0.0f;
 
+// Gathered by the callbacks as events arrive and applied once per
+// simulation step, right before the snapshot the view is built from
 struct Input {
     bool up;
     bool down;
     bool left;
     bool right;
+    // mouse movement since the last step, in degrees
+    float yaw_delta;
+    float pitch_delta;
+    // when the first event since the last step arrived, 0 if none did
+    double first_event_time;
 };
 
 Input input{};
 
+static void input_mark_event() {
+    if (input.first_event_time == 0.0) input.first_event_time = glfwGetTime();
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_REPEAT) return;
     if (key == GLFW_KEY_W) {
         input.up = (action != GLFW_RELEASE);
     } 
@@ -56,6 +120,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (key == GLFW_KEY_D) {
         input.right = (action != GLFW_RELEASE);
     }
+    if (key == GLFW_KEY_W || key == GLFW_KEY_S || key == GLFW_KEY_A || key == GLFW_KEY_D) {
+        input_mark_event();
+    }
 }
 
 
@@ -70,170 +137,210 @@ void mouse_callback(GLFWwindow* window, double cursor_x, double cursor_y) {
     float offset_y = last_cursor_y - (float)cursor_y;
 
     float sensitivity = 0.1f;
-    offset_x *= sensitivity;
-    offset_y *= sensitivity;
-
-    yaw += offset_x;
-    pitch += offset_y;
-
-    if (pitch > 89.0f)
-        pitch = 89.0f;
-    if (pitch < -89.0f)
-        pitch = -89.0f;
-
-    glm::vec3 dir;
-    dir.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    dir.y = sin(glm::radians(pitch));
-    dir.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    cam_front = glm::normalize(dir);
+    input.yaw_delta += offset_x * sensitivity;
+    input.pitch_delta += offset_y * sensitivity;
     last_cursor_x = (float)cursor_x;
     last_cursor_y = (float)cursor_y;
+    input_mark_event();
 }
 
-void frame_buffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
-}
+struct Gl_Mesh {
+    Pool_Mesh geometry;
 
-struct Platform_File {
-    void *contents;
-    int64_t content_size;
+    // decode constants for quantized positions and normals
+    glm::vec3 pos_offset;
+    glm::vec3 pos_scale;
+    int normal_encoding;
 };
 
-int64_t get_file_size(FILE *fp) {
-    int64_t size = 0;
-    fseek(fp, 0, SEEK_END);
-    size = ftell(fp);
-    rewind(fp);
-
-    return size;
+Gl_Mesh gl_mesh_create(const void *vertices, int vertex_count, Vertex_Layout *layout, const void *indices, int index_count, int index_size) {
+    Gl_Mesh result{};
+    result.pos_scale = glm::vec3(1.0f);
+    result.normal_encoding = NORMAL_ENCODING_XYZ;
+    bool added = geometry_pool_add(&geometry_pool, layout, vertices, vertex_count, indices, index_count, index_size, &result.geometry);
+    assert(added);
+    return result;
 }
 
-Platform_File read_file(const char *file_name) {
-    Platform_File result{};
-    FILE *fp = fopen(file_name, "rb");
-    if (fp == NULL) {
-        printf("Error opening file: %s\n", file_name);
-        return result;
-    }
-
-    int64_t len = get_file_size(fp);
-    char *contents = (char *)malloc((len + 1) * sizeof(char));
-    fread(contents, len, sizeof(char), fp);
-    contents[len] = '\0';
-    fclose(fp);
+// attrib_sizes lists the float component count of each interleaved attribute
+Gl_Mesh gl_mesh_create(Mesh_Data *mesh, const int *attrib_sizes, int attrib_count) {
+    Vertex_Layout layout = vertex_layout_float(attrib_sizes, attrib_count);
+    assert(layout.stride == mesh->stride * (int)sizeof(float));
+    return gl_mesh_create(mesh->vertices, mesh->vertex_count, &layout, mesh->indices, mesh->index_count, mesh->index_size);
+}
 
-    result.contents = contents;
-    result.content_size = len;
+// packed holds the vertices of mesh encoded with vertex_format_encode
+Gl_Mesh gl_mesh_create(Mesh_Data *mesh, Packed_Vertices *packed) {
+    Vertex_Layout layout = vertex_format_layout(packed->format);
+    Gl_Mesh result = gl_mesh_create(packed->data, packed->vertex_count, &layout, mesh->indices, mesh->index_count, mesh->index_size);
+    result.pos_offset = glm::make_vec3(packed->pos_offset);
+    result.pos_scale = glm::make_vec3(packed->pos_scale);
+    result.normal_encoding = packed->normal_encoding;
+    printf("Mesh vertex format %s: %d bytes per vertex\n", vertex_format_name(packed->format), layout.stride);
     return result;
 }
 
-GLuint gl_load_skymap(std::vector<char*> face_textures) {
-    stbi_set_flip_vertically_on_load(false);
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-
-    int width, height, n;
-    for (unsigned int i = 0; i < face_textures.size(); i++) {
-        unsigned char *tex_data = stbi_load(face_textures[i], &width, &height, &n, 4);
-        assert(tex_data);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data);
-        stbi_image_free(tex_data);
-    }
+// mesh vertices must be position, normal, uv
+Gl_Mesh gl_mesh_create(Mesh_Data *mesh, Vertex_Format format) {
+    assert(mesh->stride == 8);
+    Packed_Vertices packed = vertex_format_encode(mesh->vertices, mesh->vertex_count, format);
+    Gl_Mesh result = gl_mesh_create(mesh, &packed);
+    packed_vertices_free(&packed);
+    return result;
+}
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-    return texture;
+void gl_mesh_set_decode_uniforms(GLuint shader, Gl_Mesh *mesh) {
+    glUniform3fv(glGetUniformLocation(shader, "pos_offset"), 1, glm::value_ptr(mesh->pos_offset));
+    glUniform3fv(glGetUniformLocation(shader, "pos_scale"), 1, glm::value_ptr(mesh->pos_scale));
+    glUniform1i(glGetUniformLocation(shader, "normal_encoding"), mesh->normal_encoding);
 }
 
-GLuint gl_texture_create(const char *texture_path) {
-    stbi_set_flip_vertically_on_load(true);
-    int tex_width, tex_height, n;
-    unsigned char *tex_data = stbi_load(texture_path, &tex_width, &tex_height, &n, 4);
-    if (tex_data == NULL) {
-        printf("Failed to load texture: %s\n", texture_path);
-    }
+void gl_mesh_draw(Gl_Mesh *mesh) {
+    geometry_pool_draw(&mesh->geometry);
+}
 
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+void gl_mesh_draw_instanced(Gl_Mesh *mesh, int instance_count) {
+    geometry_pool_draw_instanced(&mesh->geometry, instance_count);
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+// Starts compiling src with defines inserted right after its #version line.
+// Nothing waits for the result before gl_shader_finish, so a driver that
+// compiles in the background works on several shaders at once. src need not
+// be null terminated, e.g. a mapped file.
+GLuint gl_shader_compile(GLenum type, const char *src, int src_length, const char *defines) {
+    const char *body = src;
+    if (src_length >= 8 && strncmp(src, "#version", 8) == 0) {
+        const char *end = (const char *)memchr(src, '\n', src_length);
+        body = end ? end + 1 : src + src_length;
+    }
+    const char *sources[3] = {src, defines ? defines : "", body};
+    GLint lengths[3] = {(GLint)(body - src), -1, (GLint)(src_length - (body - src))};
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_width, tex_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *)tex_data);
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 3, sources, lengths);
+    glCompileShader(shader);
+    return shader;
+}
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+// Starts linking; the shaders stay attached until gl_shader_finish
+GLuint gl_shader_link(GLuint vshader, GLuint fshader) {
+    GLuint shader = glCreateProgram();
+    glAttachShader(shader, vshader);
+    glAttachShader(shader, fshader);
+    glLinkProgram(shader);
 
-    stbi_image_free(tex_data);
-    return texture;
+    return shader;
 }
 
+// Waits for the program, prints any compile and link errors and deletes its
+// shaders
+GLuint gl_shader_finish(GLuint program) {
+    GLuint shaders[2];
+    GLsizei shader_count = 0;
+    glGetAttachedShaders(program, 2, &shader_count, shaders);
+    for (int i = 0; i < shader_count; i++) {
+        int type = 0;
+        int status = 0;
+        int n;
+        char log[512] = {};
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        const char *name = type == GL_VERTEX_SHADER ? "vertex" : "fragment";
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+        if (!status) {
+            printf("Failed to compile %s shader!\n", name);
+        }
 
-GLuint gl_shader_create(const char *vertex_src, const char *frag_src) {
-    GLuint shader = glCreateProgram();
-    int status = 0;
-    int n;
-    char log[512] = {};
+        glGetShaderInfoLog(shaders[i], 512, &n, log);
+        if (n > 0) {
+            printf("Error in %s shader!\n", name);
+            printf("%s", log);
+        }
+        glDetachShader(program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
 
-    GLuint vshader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vshader, 1, &vertex_src, nullptr);
-    glCompileShader(vshader);
-    glGetShaderiv(vshader, GL_COMPILE_STATUS, &status);
+    int status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
     if (!status) {
-        printf("Failed to compile vertex shader!\n");
+        char log[512] = {};
+        glGetProgramInfoLog(program, 512, NULL, log);
+        printf("Failed to link shader!\n%s", log);
     }
+    return program;
+}
 
-    glGetShaderInfoLog(vshader, 512, &n, log);
-    if (n > 0) {
-        printf("Error in vertex shader!\n");
-        printf(log);
-    }
+// GL_KHR_parallel_shader_compile, not in the glad build
+typedef void (APIENTRYP Gl_Max_Shader_Compiler_Threads_Proc)(GLuint count);
 
-    GLuint fshader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fshader, 1, &frag_src, nullptr);
-    glCompileShader(fshader);
-    glGetShaderiv(vshader, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        printf("Failed to compile fragment shader!\n");
-    }
-    
-    glGetShaderInfoLog(fshader, 512, &n, log);
-    if (n > 0) {
-        printf("Error in fragment shader!\n");
-        printf(log);
-    }
+enum Mesh_Id {
+    MESH_COLOR,
+    MESH_CUBE,
+    MESH_SKYMAP,
+    MESH_GROUND,
+    MESH_COUNT,
+};
 
-    glAttachShader(shader, vshader);
-    glAttachShader(shader, fshader);
-    glLinkProgram(shader);
-    glDeleteShader(vshader);
-    glDeleteShader(fshader);
+enum Shader_Id {
+    SHADER_COLOR,
+    SHADER_CUBE,
+    SHADER_SKYMAP,
+    SHADER_GROUND,
+    SHADER_GROUND_FEEDBACK,
+    SHADER_COUNT,
+};
 
-    return shader;
-}
+// Built on a worker, uploaded on the GL thread
+struct Mesh_Build {
+    const char *task_name;
+    const char *name;
+    const float *soup;
+    int soup_vertex_count;
+    int stride;
+    const int *attrib_sizes; // float attributes, NULL to encode in CUBE_VERTEX_FORMAT
+    int attrib_count;
+
+    Mesh_Data data;
+    Packed_Vertices packed;
+    Gl_Mesh mesh;
+};
 
-GLuint gl_shader_create_from_file(const char *vertex_path, const char *fragment_path) {
-    Platform_File vertex_file = read_file(vertex_path);
-    Platform_File fragment_file = read_file(fragment_path);
-    GLuint shader = gl_shader_create((char *)vertex_file.contents, (char *)fragment_file.contents);
-    return shader;
-}
+// Sources opened on a worker, compiled on the GL thread
+struct Shader_Build {
+    const char *task_name;
+    const char *vertex_path;
+    const char *fragment_path;
+    const char *defines; // "#define NAME\n" lines selecting a variant, or NULL
+
+    Asset_File vertex_file;
+    Asset_File fragment_file;
+    bool opened;
+    GLuint program;
+};
 
-int main(int argc, char **argv) {
+// Everything the startup tasks make for the frame loop
+struct Startup_State {
+    GLFWwindow *window;
+    Mesh_Build meshes[MESH_COUNT];
+    Shader_Build shaders[SHADER_COUNT];
+    GLuint crate_instance_buffer;
+    Texture_Handle diffuse_map;
+    Texture_Handle specular_map;
+    Texture_Handle sky_map;
+    bool ground_baked;
+    bool ground_loaded;
+};
+
+static const char *GROUND_SOURCE = "data/skybox/bottom.jpg";
+
+static bool startup_window(void *data) {
+    Startup_State *state = (Startup_State *)data;
     if (!glfwInit()) {
         printf("Could not initialize glfw\n");
-        return -1;
+        return false;
     }
     
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
     
@@ -241,23 +348,483 @@ int main(int argc, char **argv) {
     
     if (!window) {
         printf("Failed to create window!\n");
-        glfwTerminate();
-        return -1;
+        return false;
     }
+    state->window = window;
     
     glfwMakeContextCurrent(window);
     
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         printf("Could not initialize glad\n");
-        return -1;
+        return false;
     }
     
-    glfwSetFramebufferSizeCallback(window, frame_buffer_size_callback);
     glfwSetKeyCallback(window, key_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     
-    glfwSwapInterval(1);
+    int swap_interval = SWAP_INTERVAL;
+    if (swap_interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        printf("No adaptive vsync, waiting for every vblank\n");
+        swap_interval = -swap_interval;
+    }
+    glfwSwapInterval(swap_interval);
+
+    // let the driver compile the shaders on as many threads as it likes
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        Gl_Max_Shader_Compiler_Threads_Proc max_threads = (Gl_Max_Shader_Compiler_Threads_Proc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (max_threads) max_threads(0xFFFFFFFF);
+    }
+    return true;
+}
+
+static bool startup_mount(void *data) {
+    // one mapping for every asset, loose files when there is no pack
+    if (!asset_mount(ASSET_PACK_PATH)) {
+        printf("No %s, loading loose files\n", ASSET_PACK_PATH);
+    }
+    return true;
+}
+
+static bool startup_build_mesh(void *data) {
+    Mesh_Build *build = (Mesh_Build *)data;
+    build->data = mesh_build(build->soup, build->soup_vertex_count, build->stride, build->name);
+    if (!build->attrib_sizes) {
+        assert(build->stride == 8);
+        build->packed = vertex_format_encode(build->data.vertices, build->data.vertex_count, CUBE_VERTEX_FORMAT);
+    }
+    return true;
+}
+
+static bool startup_upload_meshes(void *data) {
+    Startup_State *state = (Startup_State *)data;
+    geometry_pool_init(&geometry_pool, 16 * 1024 * 1024, 4 * 1024 * 1024);
+    for (int i = 0; i < MESH_COUNT; i++) {
+        Mesh_Build *build = &state->meshes[i];
+        if (build->attrib_sizes) {
+            build->mesh = gl_mesh_create(&build->data, build->attrib_sizes, build->attrib_count);
+        } else {
+            build->mesh = gl_mesh_create(&build->data, &build->packed);
+            packed_vertices_free(&build->packed);
+        }
+        mesh_free(&build->data);
+    }
+
+    glCreateBuffers(1, &state->crate_instance_buffer);
+    glNamedBufferStorage(state->crate_instance_buffer, CRATE_COUNT * sizeof(Crate_Instance), NULL, GL_DYNAMIC_STORAGE_BIT);
+    return true;
+}
+
+// A missing file leaves the program 0, as before
+static bool startup_open_shader(void *data) {
+    Shader_Build *build = (Shader_Build *)data;
+    if (!asset_open(build->vertex_path, &build->vertex_file)) {
+        printf("Error opening file: %s\n", build->vertex_path);
+        return true;
+    }
+    if (!asset_open(build->fragment_path, &build->fragment_file)) {
+        printf("Error opening file: %s\n", build->fragment_path);
+        asset_close(&build->vertex_file);
+        return true;
+    }
+    build->opened = true;
+    return true;
+}
+
+static bool startup_compile_shader(void *data) {
+    Shader_Build *build = (Shader_Build *)data;
+    if (!build->opened) return true;
+    GLuint vshader = gl_shader_compile(GL_VERTEX_SHADER, (const char *)build->vertex_file.data, (int)build->vertex_file.size, build->defines);
+    GLuint fshader = gl_shader_compile(GL_FRAGMENT_SHADER, (const char *)build->fragment_file.data, (int)build->fragment_file.size, build->defines);
+    build->program = gl_shader_link(vshader, fshader);
+    asset_close(&build->vertex_file);
+    asset_close(&build->fragment_file);
+    return true;
+}
+
+static bool startup_finish_shaders(void *data) {
+    Startup_State *state = (Startup_State *)data;
+    for (int i = 0; i < SHADER_COUNT; i++) {
+        if (state->shaders[i].program) gl_shader_finish(state->shaders[i].program);
+    }
+    return true;
+}
+
+static bool startup_load_textures(void *data) {
+    Startup_State *state = (Startup_State *)data;
+    // textures decode in the background and show a placeholder until uploaded
+    texture_loader_init(COMPRESS_TEXTURES, PROGRESSIVE_TEXTURES);
+    texture_loader_set_budget(TEXTURE_BUDGET);
+
+    // crate materials, one array layer each
+    const char *crate_diffuse[CRATE_MATERIAL_COUNT] = {"data/container2.png", "data/matrix.jpg"};
+    const char *crate_specular[CRATE_MATERIAL_COUNT] = {"data/container2_specular.png", "data/container2_specular.png"};
+    if (PACK_MATERIAL_CHANNELS) {
+        state->diffuse_map = texture_load_array(crate_diffuse, crate_specular, CRATE_MATERIAL_COUNT, TEXTURE_USAGE_COLOR);
+    } else {
+        state->diffuse_map = texture_load_array(crate_diffuse, NULL, CRATE_MATERIAL_COUNT, TEXTURE_USAGE_COLOR);
+        state->specular_map = texture_load_array(crate_specular, NULL, CRATE_MATERIAL_COUNT, TEXTURE_USAGE_MASK);
+    }
+
+    const char *faces[6] = {
+        "data/skybox/right.jpg",
+        "data/skybox/left.jpg",
+        "data/skybox/top.jpg",
+        "data/skybox/bottom.jpg",
+        "data/skybox/front.jpg",
+        "data/skybox/back.jpg",
+    };
+    state->sky_map = texture_load_cube(faces);
+    return true;
+}
+
+// The first run bakes the tiled file, which is most of the ground's cost
+static bool startup_bake_ground(void *data) {
+    Startup_State *state = (Startup_State *)data;
+    char path[512];
+    state->ground_baked = virtual_texture_ensure(GROUND_SOURCE, path, sizeof(path));
+    return true;
+}
+
+static bool startup_open_ground(void *data) {
+    Startup_State *state = (Startup_State *)data;
+    // streamed a page at a time into a cache of fixed size
+    state->ground_loaded = state->ground_baked && virtual_texture_open(&ground_texture, GROUND_SOURCE, GROUND_CACHE_SIDE);
+    return true;
+}
+
+// CPU work goes to the workers and overlaps the window, GL objects are made
+// on this thread as their inputs arrive. A shader reads on a worker and
+// compiles here under the same name. The shaders are checked last, so
+// the driver compiles them while the rest is created.
+static bool startup_build_graph(Startup_State *state) {
+    int window = startup_task("window", STARTUP_MAIN, startup_window, state);
+    int mount = startup_task("mount assets", STARTUP_WORKER, startup_mount, NULL);
+
+    int meshes[MESH_COUNT];
+    for (int i = 0; i < MESH_COUNT; i++) {
+        meshes[i] = startup_task(state->meshes[i].task_name, STARTUP_WORKER, startup_build_mesh, &state->meshes[i]);
+    }
+    int upload = startup_task("upload meshes", STARTUP_MAIN, startup_upload_meshes, state);
+    startup_depends(upload, window);
+    for (int i = 0; i < MESH_COUNT; i++) startup_depends(upload, meshes[i]);
+
+    int compiles[SHADER_COUNT];
+    for (int i = 0; i < SHADER_COUNT; i++) {
+        int open = startup_task(state->shaders[i].task_name, STARTUP_WORKER, startup_open_shader, &state->shaders[i]);
+        startup_depends(open, mount);
+        compiles[i] = startup_task(state->shaders[i].task_name, STARTUP_MAIN, startup_compile_shader, &state->shaders[i]);
+        startup_depends(compiles[i], window);
+        startup_depends(compiles[i], open);
+    }
+
+    int textures = startup_task("request textures", STARTUP_MAIN, startup_load_textures, state);
+    startup_depends(textures, window);
+    startup_depends(textures, mount);
+
+    int bake_ground = startup_task("bake ground", STARTUP_WORKER, startup_bake_ground, state);
+    startup_depends(bake_ground, mount);
+    int open_ground = startup_task("open ground", STARTUP_MAIN, startup_open_ground, state);
+    startup_depends(open_ground, window);
+    startup_depends(open_ground, bake_ground);
+
+    int shaders = startup_task("finish shaders", STARTUP_MAIN, startup_finish_shaders, state);
+    for (int i = 0; i < SHADER_COUNT; i++) startup_depends(shaders, compiles[i]);
+    startup_depends(shaders, upload);
+    startup_depends(shaders, textures);
+    startup_depends(shaders, open_ground);
+    return startup_run();
+}
+
+// What the simulation hands the render thread each step. Never changed once
+// published.
+struct Frame_Snapshot {
+    glm::vec3 cam_pos;
+    glm::vec3 cam_front;
+    glm::vec3 cam_up;
+    glm::vec3 light_pos;
+    float fov;
+    int framebuffer_width;
+    int framebuffer_height;
+    uint64_t step; // counts from 1
+};
+
+// Applies the mouse movement gathered since the last step, moves the camera
+// by the held keys over delta_time and publishes the step. Main thread only,
+// like the input callbacks that feed it.
+static void simulate_step(GLFWwindow *window, Triple_Buffer *snapshots, float delta_time, double time) {
+    static uint64_t step;
+    step++;
+
+    yaw += input.yaw_delta;
+    pitch += input.pitch_delta;
+    input.yaw_delta = 0.0f;
+    input.pitch_delta = 0.0f;
+    if (pitch > 89.0f)
+        pitch = 89.0f;
+    if (pitch < -89.0f)
+        pitch = -89.0f;
+
+    glm::vec3 dir;
+    dir.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+    dir.y = sin(glm::radians(pitch));
+    dir.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+    cam_front = glm::normalize(dir);
+
+    float cam_speed = 2.5f * delta_time;
+    if (input.up) {
+        cam_pos += cam_front * cam_speed;
+    }
+    if (input.down) {
+        cam_pos -= cam_front * cam_speed;
+    } 
+    if (input.left) {
+        cam_pos -= glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
+    }
+    if (input.right) {
+        cam_pos += glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
+    }
+
+    Frame_Snapshot *frame = (Frame_Snapshot *)triple_buffer_back(snapshots);
+    frame->cam_pos = cam_pos;
+    frame->cam_front = cam_front;
+    frame->cam_up = cam_up;
+    frame->light_pos.x = 2.0f * (float)glm::cos(time);
+    frame->light_pos.y = 1.0f;
+    frame->light_pos.z = 2.0f * (float)glm::sin(time);
+    frame->fov = 45.0f;
+    glfwGetFramebufferSize(window, &frame->framebuffer_width, &frame->framebuffer_height);
+    frame->step = step;
+    // before the step can be rendered, so no earlier frame closes it
+    if (input.first_event_time > 0.0) {
+        input_latency_event(step, input.first_event_time);
+        input.first_event_time = 0.0;
+    }
+    triple_buffer_publish(snapshots);
+}
+
+// Owns the GL context from the end of startup until quit, then hands it back
+struct Render_Thread {
+    GLFWwindow *window;
+    Startup_State *state;
+    Triple_Buffer *snapshots;
+    std::atomic<bool> quit;
+};
+
+static void render_loop(Render_Thread *render) {
+    glfwMakeContextCurrent(render->window);
+    Startup_State *state = render->state;
+    Gl_Mesh color_mesh = state->meshes[MESH_COLOR].mesh;
+    Gl_Mesh cube_mesh = state->meshes[MESH_CUBE].mesh;
+    Gl_Mesh skymap_mesh = state->meshes[MESH_SKYMAP].mesh;
+    Gl_Mesh ground_mesh = state->meshes[MESH_GROUND].mesh;
+    GLuint color_shader = state->shaders[SHADER_COLOR].program;
+    GLuint cube_shader = state->shaders[SHADER_CUBE].program;
+    GLuint skymap_shader = state->shaders[SHADER_SKYMAP].program;
+    GLuint ground_shader = state->shaders[SHADER_GROUND].program;
+    GLuint ground_feedback_shader = state->shaders[SHADER_GROUND_FEEDBACK].program;
+    Texture_Handle diffuse_map = state->diffuse_map;
+    Texture_Handle specular_map = state->specular_map;
+    Texture_Handle sky_map = state->sky_map;
+    GLuint crate_instance_buffer = state->crate_instance_buffer;
+    bool ground_loaded = state->ground_loaded;
+
+    int frame_count = 0;
+    bool textures_complete = false;
+    int viewport_width = 0;
+    int viewport_height = 0;
+    // signalled when the GPU is done with a frame, by frame_count
+    GLsync frame_fences[MAX_FRAMES_IN_FLIGHT] = {};
+
+    glEnable(GL_DEPTH_TEST);
+    // filter across cube map face edges instead of clamping at them
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    while (!render->quit.load(std::memory_order_acquire)) {
+        memory_frame_begin();
+        alloc_tracker_frame_begin();
+
+        // wait out the frame MAX_FRAMES_IN_FLIGHT back before sampling the
+        // simulation, so a GPU bound frame does not start on stale input
+        GLsync *fence = &frame_fences[frame_count % MAX_FRAMES_IN_FLIGHT];
+        if (*fence) {
+            glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCE_TIMEOUT_NS);
+            glDeleteSync(*fence);
+            *fence = NULL;
+        }
+        texture_loader_update();
+
+        // the newest step, or the last one again if the simulation has not
+        // stepped since
+        const Frame_Snapshot *frame = (const Frame_Snapshot *)triple_buffer_front(render->snapshots, NULL);
+        if (frame->framebuffer_width != viewport_width || frame->framebuffer_height != viewport_height) {
+            viewport_width = frame->framebuffer_width;
+            viewport_height = frame->framebuffer_height;
+            glViewport(0, 0, viewport_width, viewport_height);
+        }
+        glm::vec3 light_pos = frame->light_pos;
+        float fov = frame->fov;
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        
+        glm::mat4 view = glm::lookAt(frame->cam_pos, frame->cam_pos + frame->cam_front, frame->cam_up);
+
+        glm::vec2 window_size = glm::vec2((float)viewport_width, (float)viewport_height);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), window_size.x / window_size.y, 0.1f, 100.0f);
+        glm::mat4 world = glm::mat4(1.0f);
+        glm::mat4 wvp = glm::mat4(1.0f);
+        glm::mat4 view_projection = projection * view;
+
+        if (ground_loaded) {
+            // pages the ground wants this frame, read back a frame or two later
+            virtual_texture_begin_feedback(&ground_texture, (int)window_size.x, (int)window_size.y);
+            glUseProgram(ground_feedback_shader);
+            glUniformMatrix4fv(glGetUniformLocation(ground_feedback_shader, "world"), 1, GL_FALSE, glm::value_ptr(world));
+            glUniformMatrix4fv(glGetUniformLocation(ground_feedback_shader, "view_projection"), 1, GL_FALSE, glm::value_ptr(view_projection));
+            virtual_texture_bind(&ground_texture, ground_feedback_shader, 2, 3, true);
+            gl_mesh_draw(&ground_mesh);
+            virtual_texture_end_feedback(&ground_texture);
+            virtual_texture_update(&ground_texture);
+        }
+
+        glDepthFunc(GL_LEQUAL);
+        glUseProgram(skymap_shader);
+        glm::mat4 sky_view = glm::mat4(glm::mat3(view));
+        glUniformMatrix4fv(glGetUniformLocation(skymap_shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glUniformMatrix4fv(glGetUniformLocation(skymap_shader, "view"), 1, GL_FALSE, glm::value_ptr(sky_view));
+
+        // a face spans 2 units at distance 1 from the eye
+        texture_use(sky_map, texture_screen_size(2.0f, 1.0f, glm::radians(fov), window_size.y));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture_get(sky_map));
+        gl_mesh_draw(&skymap_mesh);
+        glDepthFunc(GL_LESS);
+
+        glUseProgram(cube_shader);
+
+        int view_projection_loc = glGetUniformLocation(cube_shader, "view_projection");
+        int eye_pos_loc = glGetUniformLocation(cube_shader, "eye_pos");
+
+        glm::vec3 ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+        glm::vec3 diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+        glm::vec3 specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+        glUniform3f(glGetUniformLocation(cube_shader, "dir_source.direction"), 0.2f, -0.3f, 0.5f);
+
+        glUniform1f(glGetUniformLocation(cube_shader, "spot_source.cut_off"), glm::cos(glm::radians(12.5f)));
+        glUniform1f(glGetUniformLocation(cube_shader, "spot_source.outer_cut_off"), glm::cos(glm::radians(17.5f)));
+        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.position"), 1, glm::value_ptr(frame->cam_pos));
+        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.direction"), 1, glm::value_ptr(frame->cam_front));
+
+
+        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.position"), 1, glm::value_ptr(light_pos));
+        glUniform1f(glGetUniformLocation(cube_shader, "point_source.constant"), 1.0f);
+        glUniform1f(glGetUniformLocation(cube_shader, "point_source.linear"), 0.7f);
+        glUniform1f(glGetUniformLocation(cube_shader, "point_source.quadratic"), 1.8f);
+
+
+        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.ambient"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.diffuse"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.specular"), 1, glm::value_ptr(specular));       
+
+        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.ambient"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.diffuse"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.specular"), 1, glm::value_ptr(specular));
+
+        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.ambient"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.diffuse"), 1, glm::value_ptr(ambient));
+        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.specular"), 1, glm::value_ptr(specular));
+
+        glUniform1i(glGetUniformLocation(cube_shader, "material.diffuse_map"), 0);
+        glUniform1i(glGetUniformLocation(cube_shader, "material.specular_map"), 1);
+        glUniform1f(glGetUniformLocation(cube_shader, "material.shininess"), 32.0f);
+
+        glUniform3fv(eye_pos_loc, 1, glm::value_ptr(frame->cam_pos));
+        gl_mesh_set_decode_uniforms(cube_shader, &cube_mesh);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_get(diffuse_map));
+        if (!PACK_MATERIAL_CHANNELS) {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture_get(specular_map));
+        }
+
+        glm::vec3 positions[CRATE_COUNT] = {
+            glm::vec3(0.0f, 0.0f, 0.0f),
+            glm::vec3(1.0f, 2.0f, 0.3f),
+            glm::vec3(1.4f, 1.3f, -1.0f),
+            glm::vec3(2.2f, 1.9f, 1.0f),
+        };
+        // per frame data lives in the frame arena until the next frame begins
+        Crate_Instance *crates = ARENA_PUSH_ARRAY(memory_frame_arena(), Crate_Instance, CRATE_COUNT);
+        memset(crates, 0, CRATE_COUNT * sizeof(Crate_Instance));
+        float nearest_crate = 1000.0f;
+        for (int i = 0; i < CRATE_COUNT; i++) {
+            crates[i].world = glm::translate(glm::mat4(1.0f), positions[i]);
+            crates[i].layer = i % CRATE_MATERIAL_COUNT;
+            nearest_crate = glm::min(nearest_crate, glm::distance(frame->cam_pos, positions[i]));
+        }
+        // the nearest crate decides the mip levels the materials keep
+        float crate_size = texture_screen_size(1.0f, nearest_crate, glm::radians(fov), window_size.y);
+        texture_use(diffuse_map, crate_size);
+        if (!PACK_MATERIAL_CHANNELS) {
+            texture_use(specular_map, crate_size);
+        }
+        glNamedBufferSubData(crate_instance_buffer, 0, CRATE_COUNT * sizeof(Crate_Instance), crates);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, crate_instance_buffer);
+
+        // every crate and material in one draw
+        glUniformMatrix4fv(view_projection_loc, 1, GL_FALSE, glm::value_ptr(view_projection));
+        gl_mesh_draw_instanced(&cube_mesh, CRATE_COUNT);
+
+        if (ground_loaded) {
+            glUseProgram(ground_shader);
+            glUniformMatrix4fv(glGetUniformLocation(ground_shader, "world"), 1, GL_FALSE, glm::value_ptr(world));
+            glUniformMatrix4fv(glGetUniformLocation(ground_shader, "view_projection"), 1, GL_FALSE, glm::value_ptr(view_projection));
+            glUniform3f(glGetUniformLocation(ground_shader, "light_direction"), 0.2f, -0.3f, 0.5f);
+            virtual_texture_bind(&ground_texture, ground_shader, 2, 3, false);
+            gl_mesh_draw(&ground_mesh);
+        }
+
+
+        glUseProgram(color_shader);
+
+        glUniform3f(glGetUniformLocation(color_shader, "color"), 1.0f, 1.0f, 1.0f);
+
+        world = glm::mat4(1.0f);
+        world = glm::translate(world, light_pos);
+        wvp = projection * view * world;
+        glUniformMatrix4fv(glGetUniformLocation(color_shader, "wvp"), 1, GL_FALSE, glm::value_ptr(wvp));
+
+        gl_mesh_draw(&color_mesh);
+
+        {
+            ALLOC_ZONE("swap");
+            glfwSwapBuffers(render->window);
+        }
+        *fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        input_latency_swapped(frame->step, glfwGetTime());
+
+        // time to first frame and to full texture detail, from process start
+        if (frame_count == 0) {
+            printf("First frame after %.1f ms\n", startup_mark("first frame"));
+        }
+        if (!textures_complete && texture_loader_pending() == 0) {
+            printf("Textures complete after %.1f ms, %d frames\n", startup_mark("textures complete"), frame_count + 1);
+            textures_complete = true;
+            startup_report();
+        }
+        frame_count++;
+    }
+    
+    glfwMakeContextCurrent(NULL);
+}
+
+int main(int argc, char **argv) {
+    alloc_tracker_init(ALLOCATION_WARM_UP_FRAMES, ASSERT_NO_FRAME_ALLOCATIONS);
+    memory_init();
+    // workers run the startup tasks, and help decompress packed assets
+    job_system_init(0);
     
     float skybox_vertices[] = {
         // positions          
@@ -392,210 +959,76 @@ int main(int argc, char **argv) {
         -0.5f,  0.5f, -0.5f,
     };
 
-    // color
-    GLuint color_vao;
-    glGenVertexArrays(1, &color_vao);
-    glBindVertexArray(color_vao);
-
-    GLuint color_vbo;
-    glGenBuffers(1, &color_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, color_vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-
-    // cube 
-    GLuint cube_vao;
-    glGenVertexArrays(1, &cube_vao);
-    glBindVertexArray(cube_vao);
-    
-    GLuint cube_vbo;
-    glGenBuffers(1, &cube_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
-    
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_DYNAMIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-
-    // sky map
-    GLuint skymap_vao;
-    glGenVertexArrays(1, &skymap_vao);
-    glBindVertexArray(skymap_vao);
-
-    GLuint skymap_vbo;
-    glGenBuffers(1, &skymap_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, skymap_vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skybox_vertices), skybox_vertices, GL_DYNAMIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    
-    // shaders
-    
-    GLuint color_shader = gl_shader_create_from_file("color_v.glsl", "color_f.glsl");
-    GLuint cube_shader  = gl_shader_create_from_file("cube_v.glsl", "cube_f.glsl");
-    GLuint skymap_shader = gl_shader_create_from_file("skymap_v.glsl", "skymap_f.glsl");
-    
-    GLuint diffuse_map = gl_texture_create("data/container2.png");
-    GLuint specular_map = gl_texture_create("data/container2_specular.png");
-
-    std::vector<char*> faces;
-    faces.push_back("data/skybox/right.jpg");
-    faces.push_back("data/skybox/left.jpg");
-    faces.push_back("data/skybox/top.jpg");
-    faces.push_back("data/skybox/bottom.jpg");
-    faces.push_back("data/skybox/front.jpg");
-    faces.push_back("data/skybox/back.jpg");
+    float ground_vertices[] = {
+        -10.0f, -1.5f, -10.0f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,
+         10.0f, -1.5f,  10.0f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,
+         10.0f, -1.5f, -10.0f,  0.0f, 1.0f, 0.0f,   1.0f, 1.0f,
+         10.0f, -1.5f,  10.0f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,
+        -10.0f, -1.5f, -10.0f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,
+        -10.0f, -1.5f,  10.0f,  0.0f, 1.0f, 0.0f,   0.0f, 0.0f,
+    };
 
-    GLuint sky_map = gl_load_skymap(faces);
+    int color_attribs[] = {3};
+    int skymap_attribs[] = {3};
+    int ground_attribs[] = {3, 3, 2};
+    Startup_State state = {};
+    state.meshes[MESH_COLOR] = {"mesh color", "color", vertices, 36, 3, color_attribs, 1};
+    state.meshes[MESH_CUBE] = {"mesh cube", "cube", cube_vertices, 36, 8, NULL, 0};
+    state.meshes[MESH_SKYMAP] = {"mesh skymap", "skymap", skybox_vertices, 36, 3, skymap_attribs, 1};
+    state.meshes[MESH_GROUND] = {"mesh ground", "ground", ground_vertices, 6, 8, ground_attribs, 3};
+    state.shaders[SHADER_COLOR] = {"shader color", "color_v.glsl", "color_f.glsl", NULL};
+    state.shaders[SHADER_CUBE] = {"shader cube", "cube_v.glsl", "cube_f.glsl", PACK_MATERIAL_CHANNELS ? "#define PACKED_SPECULAR\n" : NULL};
+    state.shaders[SHADER_SKYMAP] = {"shader skymap", "skymap_v.glsl", "skymap_f.glsl", NULL};
+    state.shaders[SHADER_GROUND] = {"shader ground", "vt_v.glsl", "vt_f.glsl", NULL};
+    state.shaders[SHADER_GROUND_FEEDBACK] = {"shader ground feedback", "vt_v.glsl", "vt_f.glsl", "#define VT_FEEDBACK\n"};
+    if (!startup_build_graph(&state)) {
+        job_system_shutdown();
+        asset_unmount();
+        glfwTerminate();
+        return -1;
+    }
 
-    float fov = 45.0f;
-    delta_time = 0.0f;
-    float last_frame = 0.0f;
+    GLFWwindow *window = state.window;
+    Frame_Snapshot snapshot_slots[3];
+    Triple_Buffer snapshots;
+    triple_buffer_init(&snapshots, snapshot_slots, sizeof(Frame_Snapshot));
+    double last_step = glfwGetTime();
+    simulate_step(window, &snapshots, 0.0f, last_step);
+
+    // GL moves to the render thread; input and window events stay here,
+    // where GLFW wants them, so a long swap never holds up input
+    Render_Thread render = {};
+    render.window = window;
+    render.state = &state;
+    render.snapshots = &snapshots;
+    glfwMakeContextCurrent(NULL);
+    std::thread render_thread(render_loop, &render);
 
-    glEnable(GL_DEPTH_TEST);
     while (!glfwWindowShouldClose(window)) {
-        float current_frame = (float)glfwGetTime();
-        delta_time = current_frame - last_frame;
-        last_frame = current_frame;
-
-        float cam_speed = 2.5f * delta_time;
-        if (input.up) {
-            cam_pos += cam_front * cam_speed;
-        }
-        if (input.down) {
-            cam_pos -= cam_front * cam_speed;
-        } 
-        if (input.left) {
-            cam_pos -= glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
-        }
-        if (input.right) {
-            cam_pos += glm::normalize(glm::cross(cam_front, cam_up)) * cam_speed;
-        }
-
-
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        glm::mat4 view = glm::lookAt(cam_pos, cam_pos + cam_front, cam_up);
-
-        glm::vec2 window_size;
-        {
-            int w, h;
-            glfwGetFramebufferSize(window, &w, &h);
-            window_size.x = (float)w;
-            window_size.y = (float)h;
-        }
-        glm::mat4 projection = glm::perspective(glm::radians(fov), window_size.x / window_size.y, 0.1f, 100.0f);
-        glm::mat4 world = glm::mat4(1.0f);
-        glm::mat4 wvp = glm::mat4(1.0f);
-
-        glm::vec3 light_pos;
-        light_pos.x = 2.0f * (float)glm::cos(glfwGetTime());
-        light_pos.y = 1.0f;
-        light_pos.z = 2.0f * (float)glm::sin(glfwGetTime());
-
-        glDepthFunc(GL_LEQUAL);
-        glUseProgram(skymap_shader);
-        glm::mat4 sky_view = glm::mat4(glm::mat3(view));
-        glUniformMatrix4fv(glGetUniformLocation(skymap_shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(skymap_shader, "view"), 1, GL_FALSE, glm::value_ptr(sky_view));
-
-        glBindVertexArray(skymap_vao);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, sky_map);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthFunc(GL_LESS);
-
-        glBindVertexArray(cube_vao);
-        glUseProgram(cube_shader);
-
-        int world_loc = glGetUniformLocation(cube_shader, "world");
-        int wvp_loc = glGetUniformLocation(cube_shader, "wvp");
-        int eye_pos_loc = glGetUniformLocation(cube_shader, "eye_pos");
-
-        glm::vec3 ambient = glm::vec3(0.2f, 0.2f, 0.2f);
-        glm::vec3 diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
-        glm::vec3 specular = glm::vec3(1.0f, 1.0f, 1.0f);
-
-        glUniform3f(glGetUniformLocation(cube_shader, "dir_source.direction"), 0.2f, -0.3f, 0.5f);
-
-        glUniform1f(glGetUniformLocation(cube_shader, "spot_source.cut_off"), glm::cos(glm::radians(12.5f)));
-        glUniform1f(glGetUniformLocation(cube_shader, "spot_source.outer_cut_off"), glm::cos(glm::radians(17.5f)));
-        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.position"), 1, glm::value_ptr(cam_pos));
-        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.direction"), 1, glm::value_ptr(cam_front));
-
-
-        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.position"), 1, glm::value_ptr(light_pos));
-        glUniform1f(glGetUniformLocation(cube_shader, "point_source.constant"), 1.0f);
-        glUniform1f(glGetUniformLocation(cube_shader, "point_source.linear"), 0.7f);
-        glUniform1f(glGetUniformLocation(cube_shader, "point_source.quadratic"), 1.8f);
-
-
-        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.ambient"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.diffuse"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "dir_source.specular"), 1, glm::value_ptr(specular));       
-
-        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.ambient"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.diffuse"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "point_source.specular"), 1, glm::value_ptr(specular));
-
-        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.ambient"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.diffuse"), 1, glm::value_ptr(ambient));
-        glUniform3fv(glGetUniformLocation(cube_shader, "spot_source.specular"), 1, glm::value_ptr(specular));
-
-        glUniform1i(glGetUniformLocation(cube_shader, "material.diffuse_map"), 0);
-        glUniform1i(glGetUniformLocation(cube_shader, "material.specular_map"), 1);
-        glUniform1f(glGetUniformLocation(cube_shader, "material.shininess"), 32.0f);
-
-        glUniform3fv(eye_pos_loc, 1, glm::value_ptr(cam_pos));
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuse_map);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specular_map);
-
-        glm::vec3 positions[4] = {
-            glm::vec3(0.0f, 0.0f, 0.0f),
-            glm::vec3(1.0f, 2.0f, 0.3f),
-            glm::vec3(1.4f, 1.3f, -1.0f),
-            glm::vec3(2.2f, 1.9f, 1.0f),
-        };
-        for (int i = 0; i < 4; i++) {
-            world = glm::mat4(1.0f);
-            world = glm::translate(world, positions[i]);
-            wvp = projection * view * world;
-            glUniformMatrix4fv(world_loc, 1, GL_FALSE, glm::value_ptr(world));
-            glUniformMatrix4fv(wvp_loc, 1, GL_FALSE, glm::value_ptr(wvp));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-
-
-        glBindVertexArray(color_vao);
-        glUseProgram(color_shader);
-
-        glUniform3f(glGetUniformLocation(color_shader, "color"), 1.0f, 1.0f, 1.0f);
-
-        world = glm::mat4(1.0f);
-        world = glm::translate(world, light_pos);
-        wvp = projection * view * world;
-        glUniformMatrix4fv(glGetUniformLocation(color_shader, "wvp"), 1, GL_FALSE, glm::value_ptr(wvp));
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glfwWaitEventsTimeout(SIMULATION_STEP);
+        double now = glfwGetTime();
+        simulate_step(window, &snapshots, (float)(now - last_step), now);
+        last_step = now;
+    }
+    render.quit.store(true, std::memory_order_release);
+    render_thread.join();
+    glfwMakeContextCurrent(window);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // if the textures never completed
+    startup_report();
+    job_system_shutdown();
+    texture_loader_shutdown();
+    if (state.ground_loaded) {
+        virtual_texture_close(&ground_texture);
     }
-    
+    asset_unmount();
+    glDeleteBuffers(1, &state.crate_instance_buffer);
+    geometry_pool_release(&geometry_pool);
     glfwDestroyWindow(window);
     glfwTerminate();
+    memory_shutdown();
+    alloc_tracker_report();
+    input_latency_report();
     
     return 0;
 }
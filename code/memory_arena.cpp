@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "memory_arena.h"
+#include "platform.h"
+
+// Releases the thread's scratch arena when the thread exits
+struct Thread_Scratch {
+    Arena arena;
+    ~Thread_Scratch() {
+        arena_release(&arena);
+    }
+};
+
+static Arena frame_arena;
+static thread_local Thread_Scratch thread_scratch;
+
+bool arena_init(Arena *arena, size_t reserve) {
+    *arena = {};
+    reserve = (reserve + MEMORY_COMMIT_SIZE - 1) / MEMORY_COMMIT_SIZE * MEMORY_COMMIT_SIZE;
+    arena->base = (uint8_t *)platform_reserve(reserve);
+    if (!arena->base) {
+        printf("Failed to reserve %zu MB of address space\n", reserve / (1024 * 1024));
+        return false;
+    }
+    arena->reserved = reserve;
+    return true;
+}
+
+void arena_release(Arena *arena) {
+    if (arena->base) platform_release(arena->base, arena->reserved);
+    *arena = {};
+}
+
+void *arena_push(Arena *arena, size_t size, size_t alignment) {
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+    size_t start = (arena->used + alignment - 1) & ~(alignment - 1);
+    if (start > arena->reserved || size > arena->reserved - start) return NULL;
+    size_t end = start + size;
+    if (end > arena->committed) {
+        size_t commit_end = (end + MEMORY_COMMIT_SIZE - 1) / MEMORY_COMMIT_SIZE * MEMORY_COMMIT_SIZE;
+        if (!platform_commit(arena->base + arena->committed, commit_end - arena->committed)) return NULL;
+        arena->committed = commit_end;
+    }
+    arena->used = end;
+    if (end > arena->peak) arena->peak = end;
+    return arena->base + start;
+}
+
+void *arena_grow(Arena *arena, void *pointer, size_t old_size, size_t new_size) {
+    if (!pointer) return arena_push(arena, new_size);
+    uint8_t *start = (uint8_t *)pointer;
+    if (start + old_size == arena->base + arena->used) {
+        // the last allocation, extend it where it is
+        size_t offset = (size_t)(start - arena->base);
+        Arena_Temp temp = {arena, offset};
+        arena_temp_end(temp);
+        void *grown = arena_push(arena, new_size, 1);
+        if (grown) return grown;
+        arena->used = offset + old_size;
+        return NULL;
+    }
+    void *copy = arena_push(arena, new_size);
+    if (copy) memcpy(copy, pointer, old_size < new_size ? old_size : new_size);
+    return copy;
+}
+
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+bool arena_owns(const Arena *arena, const void *pointer) {
+    const uint8_t *p = (const uint8_t *)pointer;
+    return arena->base && p >= arena->base && p < arena->base + arena->reserved;
+}
+
+Arena_Temp arena_temp_begin(Arena *arena) {
+    Arena_Temp temp = {arena, arena->used};
+    return temp;
+}
+
+void arena_temp_end(Arena_Temp temp) {
+    assert(temp.used <= temp.arena->used);
+    temp.arena->used = temp.used;
+}
+
+void memory_init() {
+    arena_init(&frame_arena, MEMORY_FRAME_ARENA_SIZE);
+}
+
+void memory_shutdown() {
+    arena_release(&frame_arena);
+}
+
+void memory_frame_begin() {
+    arena_reset(&frame_arena);
+}
+
+Arena *memory_frame_arena() {
+    return &frame_arena;
+}
+
+Arena *memory_thread_scratch() {
+    Arena *arena = &thread_scratch.arena;
+    if (!arena->base) arena_init(arena, MEMORY_SCRATCH_ARENA_SIZE);
+    return arena;
+}
@@ -0,0 +1,58 @@
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Linear arenas on reserved address space. An arena reserves its whole
+// capacity up front and commits pages only as it grows, so it never moves or
+// copies. Memory goes back in bulk: to a temp marker taken earlier, or all
+// of it on reset. Committed pages stay committed, so an arena that has
+// reached its high water mark allocates with a pointer bump and nothing else.
+//
+// Two kinds are provided:
+// - the frame arena, for the render thread, reset at the top of every frame
+// - a scratch arena per thread, for decoders and loaders, made on first use
+//   and released when the thread exits
+
+#define MEMORY_COMMIT_SIZE (64 * 1024)
+#define MEMORY_FRAME_ARENA_SIZE ((size_t)256 * 1024 * 1024)
+#define MEMORY_SCRATCH_ARENA_SIZE ((size_t)1024 * 1024 * 1024)
+
+struct Arena {
+    uint8_t *base;
+    size_t reserved;
+    size_t committed;
+    size_t used;
+    size_t peak;
+};
+
+// Everything pushed after arena_temp_begin is popped by arena_temp_end
+struct Arena_Temp {
+    Arena *arena;
+    size_t used;
+};
+
+bool arena_init(Arena *arena, size_t reserve);
+void arena_release(Arena *arena);
+// NULL once the reservation is used up. alignment is a power of two.
+void *arena_push(Arena *arena, size_t size, size_t alignment = 16);
+// Grows the last allocation in place, else pushes a copy
+void *arena_grow(Arena *arena, void *pointer, size_t old_size, size_t new_size);
+void arena_reset(Arena *arena);
+bool arena_owns(const Arena *arena, const void *pointer);
+
+Arena_Temp arena_temp_begin(Arena *arena);
+void arena_temp_end(Arena_Temp temp);
+
+#define ARENA_PUSH_ARRAY(arena, type, count) ((type *)arena_push((arena), sizeof(type) * (size_t)(count), alignof(type)))
+
+void memory_init();
+void memory_shutdown();
+// Call at the top of each frame; everything from the previous frame is gone
+void memory_frame_begin();
+Arena *memory_frame_arena();
+// This thread's scratch arena
+Arena *memory_thread_scratch();
+
+#endif // MEMORY_ARENA_H
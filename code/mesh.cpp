@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mesh.h"
+
+static uint32_t vertex_hash(const float *v, int stride) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < stride; i++) {
+        float f = v[i] == 0.0f ? 0.0f : v[i]; // -0.0 and 0.0 weld together
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash;
+}
+
+static bool vertex_equal(const float *a, const float *b, int stride) {
+    for (int i = 0; i < stride; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+int mesh_weld(const float *soup, int soup_vertex_count, int stride, float *out_vertices, uint32_t *out_indices) {
+    int table_size = 1;
+    while (table_size < soup_vertex_count * 2) table_size <<= 1;
+    int *table = (int *)malloc(table_size * sizeof(int));
+    memset(table, 0xff, table_size * sizeof(int));
+
+    int vertex_count = 0;
+    for (int i = 0; i < soup_vertex_count; i++) {
+        const float *v = soup + i * stride;
+        uint32_t slot = vertex_hash(v, stride) & (table_size - 1);
+        for (;;) {
+            int existing = table[slot];
+            if (existing < 0) {
+                memcpy(out_vertices + vertex_count * stride, v, stride * sizeof(float));
+                table[slot] = vertex_count;
+                out_indices[i] = vertex_count++;
+                break;
+            }
+            if (vertex_equal(out_vertices + existing * stride, v, stride)) {
+                out_indices[i] = existing;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+    }
+
+    free(table);
+    return vertex_count;
+}
+
+float mesh_compute_acmr(const uint32_t *indices, int index_count, int vertex_count, int cache_size) {
+    if (index_count < 3) return 0.0f;
+    int *cache_time = (int *)malloc(vertex_count * sizeof(int));
+    for (int i = 0; i < vertex_count; i++) cache_time[i] = -cache_size - 1;
+
+    int time = 0;
+    int misses = 0;
+    for (int i = 0; i < index_count; i++) {
+        uint32_t v = indices[i];
+        if (time - cache_time[v] > cache_size) {
+            cache_time[v] = time++;
+            misses++;
+        }
+    }
+
+    free(cache_time);
+    return (float)misses / (float)(index_count / 3);
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): fan around the most recently cached vertex,
+// falling back to a dead-end stack and then a linear scan when a fan runs dry.
+static int tipsify_next_vertex(int *candidates, int candidate_count, int *live, int *cache_time, int time, int cache_size,
+                               int *dead_end, int *dead_end_count, int *cursor, int vertex_count) {
+    int best = -1;
+    int best_priority = -1;
+    for (int i = 0; i < candidate_count; i++) {
+        int v = candidates[i];
+        if (live[v] <= 0) continue;
+        int priority = 0;
+        if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+            priority = time - cache_time[v];
+        }
+        if (priority > best_priority) {
+            best = v;
+            best_priority = priority;
+        }
+    }
+    if (best >= 0) return best;
+
+    while (*dead_end_count > 0) {
+        int v = dead_end[--(*dead_end_count)];
+        if (live[v] > 0) return v;
+    }
+    while (*cursor < vertex_count) {
+        int v = (*cursor)++;
+        if (live[v] > 0) return v;
+    }
+    return -1;
+}
+
+void mesh_optimize_vertex_cache(uint32_t *indices, int index_count, int vertex_count, int cache_size) {
+    int triangle_count = index_count / 3;
+    if (triangle_count == 0) return;
+
+    // vertex -> triangle adjacency, CSR layout
+    int *live = (int *)calloc(vertex_count, sizeof(int));
+    int *offsets = (int *)malloc((vertex_count + 1) * sizeof(int));
+    int *adjacency = (int *)malloc(index_count * sizeof(int));
+    for (int i = 0; i < index_count; i++) live[indices[i]]++;
+    offsets[0] = 0;
+    for (int v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + live[v];
+    int *fill = (int *)malloc(vertex_count * sizeof(int));
+    memcpy(fill, offsets, vertex_count * sizeof(int));
+    for (int i = 0; i < index_count; i++) adjacency[fill[indices[i]]++] = i / 3;
+    free(fill);
+
+    int *cache_time = (int *)calloc(vertex_count, sizeof(int));
+    bool *emitted = (bool *)calloc(triangle_count, sizeof(bool));
+    int *dead_end = (int *)malloc(index_count * sizeof(int));
+    int *candidates = (int *)malloc(index_count * sizeof(int));
+    uint32_t *output = (uint32_t *)malloc(index_count * sizeof(uint32_t));
+
+    int time = cache_size + 1;
+    int dead_end_count = 0;
+    int cursor = 1;
+    int output_count = 0;
+    int fan = 0;
+    while (fan >= 0) {
+        int candidate_count = 0;
+        for (int a = offsets[fan]; a < offsets[fan + 1]; a++) {
+            int t = adjacency[a];
+            if (emitted[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                int v = indices[t * 3 + k];
+                output[output_count++] = v;
+                dead_end[dead_end_count++] = v;
+                candidates[candidate_count++] = v;
+                live[v]--;
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+        fan = tipsify_next_vertex(candidates, candidate_count, live, cache_time, time, cache_size,
+                                  dead_end, &dead_end_count, &cursor, vertex_count);
+    }
+    assert(output_count == triangle_count * 3);
+    memcpy(indices, output, output_count * sizeof(uint32_t));
+
+    free(output);
+    free(candidates);
+    free(dead_end);
+    free(emitted);
+    free(cache_time);
+    free(adjacency);
+    free(offsets);
+    free(live);
+}
+
+void mesh_optimize_vertex_fetch(float *vertices, int vertex_count, int stride, uint32_t *indices, int index_count) {
+    int *remap = (int *)malloc(vertex_count * sizeof(int));
+    memset(remap, 0xff, vertex_count * sizeof(int));
+    float *reordered = (float *)malloc(vertex_count * stride * sizeof(float));
+
+    int next = 0;
+    for (int i = 0; i < index_count; i++) {
+        uint32_t v = indices[i];
+        if (remap[v] < 0) {
+            memcpy(reordered + next * stride, vertices + v * stride, stride * sizeof(float));
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+    // unreferenced vertices keep their relative order at the end
+    for (int v = 0; v < vertex_count; v++) {
+        if (remap[v] < 0) {
+            memcpy(reordered + next * stride, vertices + v * stride, stride * sizeof(float));
+            remap[v] = next++;
+        }
+    }
+
+    memcpy(vertices, reordered, vertex_count * stride * sizeof(float));
+    free(reordered);
+    free(remap);
+}
+
+Mesh_Data mesh_build(const float *soup, int soup_vertex_count, int stride, const char *name) {
+    Mesh_Data mesh{};
+    mesh.stride = stride;
+    mesh.index_count = soup_vertex_count;
+
+    float *vertices = (float *)malloc(soup_vertex_count * stride * sizeof(float));
+    uint32_t *indices = (uint32_t *)malloc(soup_vertex_count * sizeof(uint32_t));
+    int vertex_count = mesh_weld(soup, soup_vertex_count, stride, vertices, indices);
+    vertices = (float *)realloc(vertices, vertex_count * stride * sizeof(float));
+
+    // drawn as a soup every vertex is transformed, so the original ACMR is always 3
+    float acmr_soup = 3.0f;
+    float acmr_welded = mesh_compute_acmr(indices, soup_vertex_count, vertex_count, MESH_VERTEX_CACHE_SIZE);
+    mesh_optimize_vertex_cache(indices, soup_vertex_count, vertex_count, MESH_VERTEX_CACHE_SIZE);
+    mesh_optimize_vertex_fetch(vertices, vertex_count, stride, indices, soup_vertex_count);
+    float acmr_optimized = mesh_compute_acmr(indices, soup_vertex_count, vertex_count, MESH_VERTEX_CACHE_SIZE);
+
+    printf("Mesh %s: %d -> %d vertices, ACMR %.3f (soup) %.3f (welded) -> %.3f\n",
+           name, soup_vertex_count, vertex_count, acmr_soup, acmr_welded, acmr_optimized);
+
+    mesh.vertices = vertices;
+    mesh.vertex_count = vertex_count;
+    if (vertex_count <= 0xFFFF) {
+        uint16_t *short_indices = (uint16_t *)malloc(soup_vertex_count * sizeof(uint16_t));
+        for (int i = 0; i < soup_vertex_count; i++) short_indices[i] = (uint16_t)indices[i];
+        free(indices);
+        mesh.indices = short_indices;
+        mesh.index_size = 2;
+    } else {
+        mesh.indices = indices;
+        mesh.index_size = 4;
+    }
+    return mesh;
+}
+
+void mesh_free(Mesh_Data *mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    *mesh = {};
+}
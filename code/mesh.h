@@ -0,0 +1,34 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+
+// Post-transform cache size used for optimization and ACMR reporting.
+#define MESH_VERTEX_CACHE_SIZE 16
+
+// Indexed mesh built from a non-indexed triangle soup.
+// Vertices are interleaved floats, 'stride' floats per vertex.
+struct Mesh_Data {
+    float *vertices;
+    int vertex_count;
+    int stride;
+
+    void *indices;
+    int index_count;
+    int index_size; // 2 or 4 bytes
+};
+
+// Welds identical vertices, reorders triangles for the post-transform cache and
+// vertices for fetch locality, then picks the smallest index width that fits.
+Mesh_Data mesh_build(const float *soup, int soup_vertex_count, int stride, const char *name);
+void mesh_free(Mesh_Data *mesh);
+
+// Returns the welded vertex count. out_vertices must hold soup_vertex_count vertices.
+int mesh_weld(const float *soup, int soup_vertex_count, int stride, float *out_vertices, uint32_t *out_indices);
+void mesh_optimize_vertex_cache(uint32_t *indices, int index_count, int vertex_count, int cache_size);
+void mesh_optimize_vertex_fetch(float *vertices, int vertex_count, int stride, uint32_t *indices, int index_count);
+
+// Average cache miss ratio: transformed vertices per triangle with a FIFO cache.
+float mesh_compute_acmr(const uint32_t *indices, int index_count, int vertex_count, int cache_size);
+
+#endif // MESH_H
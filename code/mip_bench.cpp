@@ -0,0 +1,117 @@
+// Mip chain generation throughput per filter, single threaded and on every
+// core, and the alpha test coverage of each level with and without the
+// coverage scaling of BAKE_ALPHA_COVERAGE, for images that have alpha.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "mip_gen.h"
+#include "job_system.h"
+
+// the same cutoff the bake uses, TEXTURE_BAKE_ALPHA_CUTOFF
+#define ALPHA_CUTOFF 0.5f
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float coverage(const uint8_t *rgba, int pixel_count) {
+    int covered = 0;
+    for (int i = 0; i < pixel_count; i++) {
+        if (rgba[i * 4 + 3] > ALPHA_CUTOFF * 255.0f) covered++;
+    }
+    return (float)covered / (float)pixel_count;
+}
+
+static bool has_alpha(const uint8_t *rgba, int pixel_count) {
+    for (int i = 0; i < pixel_count; i++) {
+        if (rgba[i * 4 + 3] != 255) return true;
+    }
+    return false;
+}
+
+static void free_levels(uint8_t **levels, int level_count) {
+    for (int i = 1; i < level_count; i++) {
+        free(levels[i]);
+        levels[i] = NULL;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *default_paths[] = {
+        "data/container2.png",
+        "data/cage.png",
+        "data/skybox/front.jpg",
+    };
+    const char **paths = default_paths;
+    int path_count = sizeof(default_paths) / sizeof(default_paths[0]);
+    if (argc > 1) {
+        paths = (const char **)(argv + 1);
+        path_count = argc - 1;
+    }
+
+    // the caller and a worker on every other core
+    job_system_init(0);
+    printf("vertical pass: %s\n", mip_simd_name());
+    printf("%-30s %-8s %12s %12s\n", "image", "filter", "MPix/s (1)", "MPix/s (N)");
+    for (int p = 0; p < path_count; p++) {
+        int width, height, n;
+        uint8_t *rgba = stbi_load(paths[p], &width, &height, &n, 4);
+        if (rgba == NULL) {
+            printf("Failed to load texture: %s\n", paths[p]);
+            continue;
+        }
+        double megapixels = (double)width * height / 1e6;
+        int level_count = mip_level_count(width, height);
+        uint8_t *levels[32] = {};
+
+        for (int f = 0; f < MIP_FILTER_COUNT; f++) {
+            Mip_Options options = {};
+            options.filter = (Mip_Filter)f;
+            options.srgb = true;
+
+            options.thread_count = 1;
+            double start = now_seconds();
+            mip_generate(rgba, width, height, level_count, &options, levels);
+            double single = now_seconds() - start;
+            free_levels(levels, level_count);
+
+            options.thread_count = 0;
+            start = now_seconds();
+            mip_generate(rgba, width, height, level_count, &options, levels);
+            double parallel = now_seconds() - start;
+            free_levels(levels, level_count);
+
+            printf("%-30s %-8s %12.2f %12.2f\n", paths[p], mip_filter_name(options.filter), megapixels / single, megapixels / parallel);
+        }
+
+        if (has_alpha(rgba, width * height)) {
+            uint8_t *scaled[32] = {};
+            Mip_Options options = {};
+            options.filter = MIP_FILTER_KAISER;
+            options.srgb = true;
+            options.thread_count = 0;
+            mip_generate(rgba, width, height, level_count, &options, levels);
+            options.alpha_cutoff = ALPHA_CUTOFF;
+            mip_generate(rgba, width, height, level_count, &options, scaled);
+
+            printf("%s alpha coverage at %.2f, level 0 %.3f\n", paths[p], ALPHA_CUTOFF, coverage(rgba, width * height));
+            printf("%6s %10s %10s\n", "level", "plain", "scaled");
+            for (int level = 1; level < level_count; level++) {
+                int w = width >> level > 0 ? width >> level : 1;
+                int h = height >> level > 0 ? height >> level : 1;
+                printf("%6d %10.3f %10.3f\n", level, coverage(levels[level], w * h), coverage(scaled[level], w * h));
+            }
+            free_levels(levels, level_count);
+            free_levels(scaled, level_count);
+        }
+        stbi_image_free(rgba);
+    }
+    printf("(N = %d threads)\n", job_thread_count() + 1);
+    job_system_shutdown();
+    return 0;
+}
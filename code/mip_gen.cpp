@@ -0,0 +1,377 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <vector>
+
+#include "mip_gen.h"
+#include "job_system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_SSE2 1
+#include <emmintrin.h>
+#endif
+// The AVX2 path is built whatever the arch flags and picked at runtime, so
+// the default SSE2 build still uses it on CPUs that have it
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MIP_AVX2 1
+#define MIP_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MIP_AVX2 1
+#define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+// Destination rows per piece of a level. Neighbouring bands both filter the
+// source rows they share, so smaller bands repeat more of the work.
+#define MIP_BAND_ROWS 64
+#define MIP_PI 3.14159265358979f
+
+// Per destination texel: taps source indices (already clamped) and weights
+struct Mip_Kernel {
+    int taps;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+struct Srgb_Tables {
+    float to_linear[256];
+    uint8_t from_linear[4096];
+};
+
+static Srgb_Tables srgb_tables_build() {
+    Srgb_Tables tables;
+    for (int i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        tables.to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < 4096; i++) {
+        float l = i / 4095.0f;
+        float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+        tables.from_linear[i] = (uint8_t)(c * 255.0f + 0.5f);
+    }
+    return tables;
+}
+
+static const Srgb_Tables *srgb_tables() {
+    static const Srgb_Tables tables = srgb_tables_build();
+    return &tables;
+}
+
+const char *mip_filter_name(Mip_Filter filter) {
+    switch (filter) {
+    case MIP_FILTER_BOX: return "box";
+    case MIP_FILTER_KAISER: return "kaiser";
+    case MIP_FILTER_LANCZOS: return "lanczos";
+    default: return "unknown";
+    }
+}
+
+int mip_level_count(int width, int height) {
+    int size = width > height ? width : height;
+    int count = 1;
+    while (size > 1) {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+static float sinc(float x) {
+    if (fabsf(x) < 1e-6f) return 1.0f;
+    return sinf(MIP_PI * x) / (MIP_PI * x);
+}
+
+// Zeroth order modified Bessel function of the first kind
+static float bessel_i0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+        if (term < sum * 1e-7f) break;
+    }
+    return sum;
+}
+
+static float filter_radius(Mip_Filter filter) {
+    return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+// t is the distance from the destination texel center in destination texels
+static float filter_weight(Mip_Filter filter, float t) {
+    float radius = filter_radius(filter);
+    if (fabsf(t) >= radius) return 0.0f;
+    switch (filter) {
+    case MIP_FILTER_KAISER: {
+        const float alpha = 4.0f;
+        float r = t / radius;
+        return sinc(t) * bessel_i0(alpha * sqrtf(1.0f - r * r)) / bessel_i0(alpha);
+    }
+    case MIP_FILTER_LANCZOS:
+        return sinc(t) * sinc(t / radius);
+    default:
+        return 1.0f;
+    }
+}
+
+static void kernel_build(Mip_Kernel *kernel, Mip_Filter filter, int src_size, int dst_size) {
+    float scale = (float)src_size / (float)dst_size;
+    // when magnifying the filter keeps its width in source texels
+    float support = scale > 1.0f ? scale : 1.0f;
+    float radius = filter_radius(filter) * support;
+    kernel->taps = (int)ceilf(2.0f * radius) + 1;
+    kernel->index.resize((size_t)dst_size * kernel->taps);
+    kernel->weight.resize((size_t)dst_size * kernel->taps);
+
+    for (int d = 0; d < dst_size; d++) {
+        float center = (d + 0.5f) * scale;
+        int first = (int)floorf(center - radius);
+        int *index = &kernel->index[(size_t)d * kernel->taps];
+        float *weight = &kernel->weight[(size_t)d * kernel->taps];
+        float total = 0.0f;
+        for (int t = 0; t < kernel->taps; t++) {
+            int i = first + t;
+            weight[t] = filter_weight(filter, (i + 0.5f - center) / support);
+            index[t] = i < 0 ? 0 : (i >= src_size ? src_size - 1 : i);
+            total += weight[t];
+        }
+        for (int t = 0; t < kernel->taps; t++) {
+            weight[t] /= total;
+        }
+    }
+}
+
+static void filter_row_horizontal(const float *src, float *dst, int dst_width, const Mip_Kernel *kernel) {
+    for (int d = 0; d < dst_width; d++) {
+        const int *index = &kernel->index[(size_t)d * kernel->taps];
+        const float *weight = &kernel->weight[(size_t)d * kernel->taps];
+#ifdef MIP_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < kernel->taps; t++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(src + index[t] * 4)));
+        }
+        _mm_storeu_ps(dst + d * 4, sum);
+#else
+        float sum[4] = {};
+        for (int t = 0; t < kernel->taps; t++) {
+            for (int c = 0; c < 4; c++) {
+                sum[c] += weight[t] * src[index[t] * 4 + c];
+            }
+        }
+        memcpy(dst + d * 4, sum, sizeof(sum));
+#endif
+    }
+}
+
+#ifdef MIP_AVX2
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // the OS must save the ymm registers too
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static const bool mip_avx2 = cpu_has_avx2();
+
+// Returns how many floats it did, the rest is left to the narrower loops
+MIP_TARGET_AVX2 static int accumulate_row_avx2(float *dst, const float *src, float weight, int count) {
+    int i = 0;
+    __m256 w8 = _mm256_set1_ps(weight);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(w8, _mm256_loadu_ps(src + i))));
+    }
+    return i;
+}
+#endif
+
+const char *mip_simd_name() {
+#ifdef MIP_AVX2
+    if (mip_avx2) return "avx2";
+#endif
+#ifdef MIP_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// dst += weight * src over count floats
+static void accumulate_row(float *dst, const float *src, float weight, int count) {
+    int i = 0;
+#ifdef MIP_AVX2
+    if (mip_avx2) i = accumulate_row_avx2(dst, src, weight, count);
+#endif
+#if defined(MIP_SSE2)
+    __m128 w4 = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w4, _mm_loadu_ps(src + i))));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] += weight * src[i];
+    }
+}
+
+// Filters destination rows [first_row, end_row). The source rows the band
+// needs are filtered horizontally first, so bands only share the source.
+static void filter_band(const float *src, int src_width, float *dst, int dst_width,
+                        const Mip_Kernel *kernel_x, const Mip_Kernel *kernel_y, int first_row, int end_row) {
+    int lo = kernel_y->index[(size_t)first_row * kernel_y->taps];
+    int hi = kernel_y->index[(size_t)end_row * kernel_y->taps - 1];
+    size_t row_floats = (size_t)dst_width * 4;
+    std::vector<float> temp((size_t)(hi - lo + 1) * row_floats);
+    for (int y = lo; y <= hi; y++) {
+        filter_row_horizontal(src + (size_t)y * src_width * 4, &temp[(size_t)(y - lo) * row_floats], dst_width, kernel_x);
+    }
+
+    for (int y = first_row; y < end_row; y++) {
+        float *row = dst + (size_t)y * row_floats;
+        memset(row, 0, row_floats * sizeof(float));
+        const int *index = &kernel_y->index[(size_t)y * kernel_y->taps];
+        const float *weight = &kernel_y->weight[(size_t)y * kernel_y->taps];
+        for (int t = 0; t < kernel_y->taps; t++) {
+            if (weight[t] == 0.0f) continue;
+            accumulate_row(row, &temp[(size_t)(index[t] - lo) * row_floats], weight[t], (int)row_floats);
+        }
+    }
+}
+
+struct Mip_Filter_Job {
+    const float *src;
+    int src_width;
+    float *dst;
+    int dst_width;
+    const Mip_Kernel *kernel_x;
+    const Mip_Kernel *kernel_y;
+};
+
+static void filter_band_job(void *data, int first_row, int end_row) {
+    Mip_Filter_Job *job = (Mip_Filter_Job *)data;
+    filter_band(job->src, job->src_width, job->dst, job->dst_width, job->kernel_x, job->kernel_y, first_row, end_row);
+}
+
+static void filter_level(const float *src, int src_width, int src_height, float *dst, int dst_width, int dst_height,
+                         Mip_Filter filter, int thread_count) {
+    Mip_Kernel kernel_x, kernel_y;
+    kernel_build(&kernel_x, filter, src_width, dst_width);
+    kernel_build(&kernel_y, filter, src_height, dst_height);
+
+    if (thread_count == 1) {
+        filter_band(src, src_width, dst, dst_width, &kernel_x, &kernel_y, 0, dst_height);
+        return;
+    }
+    Mip_Filter_Job job = {src, src_width, dst, dst_width, &kernel_x, &kernel_y};
+    job_parallel_for(dst_height, MIP_BAND_ROWS, filter_band_job, &job);
+}
+
+static float alpha_coverage(const float *rgba, int pixel_count, float cutoff, float scale) {
+    int covered = 0;
+    for (int i = 0; i < pixel_count; i++) {
+        if (rgba[i * 4 + 3] * scale > cutoff) covered++;
+    }
+    return (float)covered / (float)pixel_count;
+}
+
+// Alpha scale that brings the coverage of a level closest to target
+static float alpha_coverage_scale(const float *rgba, int pixel_count, float cutoff, float target) {
+    float lo = 0.0f;
+    float hi = 4.0f;
+    for (int i = 0; i < 12; i++) {
+        float mid = (lo + hi) * 0.5f;
+        if (alpha_coverage(rgba, pixel_count, cutoff, mid) < target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo + hi) * 0.5f;
+}
+
+static float clamp01(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// Clamps filter overshoot in place, so it does not carry into the next level
+static void quantize_level(float *rgba, int pixel_count, bool srgb, float alpha_scale, uint8_t *out) {
+    const Srgb_Tables *tables = srgb_tables();
+    for (int i = 0; i < pixel_count; i++) {
+        float *p = rgba + i * 4;
+        for (int c = 0; c < 3; c++) {
+            p[c] = clamp01(p[c]);
+            out[i * 4 + c] = srgb ? tables->from_linear[(int)(p[c] * 4095.0f + 0.5f)] : (uint8_t)(p[c] * 255.0f + 0.5f);
+        }
+        p[3] = clamp01(p[3]);
+        out[i * 4 + 3] = (uint8_t)(clamp01(p[3] * alpha_scale) * 255.0f + 0.5f);
+    }
+}
+
+static float *to_linear(const uint8_t *rgba, size_t pixel_count, bool srgb) {
+    const Srgb_Tables *tables = srgb_tables();
+    float *linear = (float *)malloc(pixel_count * 4 * sizeof(float));
+    for (size_t i = 0; i < pixel_count * 4; i += 4) {
+        for (int c = 0; c < 3; c++) {
+            linear[i + c] = srgb ? tables->to_linear[rgba[i + c]] : rgba[i + c] / 255.0f;
+        }
+        linear[i + 3] = rgba[i + 3] / 255.0f;
+    }
+    return linear;
+}
+
+void mip_resample(const uint8_t *rgba, int width, int height, uint8_t *out, int out_width, int out_height, const Mip_Options *options) {
+    float *src = to_linear(rgba, (size_t)width * height, options->srgb);
+    float *dst = (float *)malloc((size_t)out_width * out_height * 4 * sizeof(float));
+    filter_level(src, width, height, dst, out_width, out_height, options->filter, options->thread_count);
+    quantize_level(dst, out_width * out_height, options->srgb, 1.0f, out);
+    free(src);
+    free(dst);
+}
+
+void mip_generate(const uint8_t *rgba, int width, int height, int level_count, const Mip_Options *options, uint8_t **out_levels) {
+    if (level_count <= 1) return;
+    size_t pixel_count = (size_t)width * height;
+    float *src = to_linear(rgba, pixel_count, options->srgb);
+
+    float target_coverage = 0.0f;
+    if (options->alpha_cutoff > 0.0f) {
+        target_coverage = alpha_coverage(src, (int)pixel_count, options->alpha_cutoff, 1.0f);
+    }
+
+    int src_width = width;
+    int src_height = height;
+    float *dst = (float *)malloc(pixel_count * 4 * sizeof(float));
+    for (int level = 1; level < level_count; level++) {
+        int dst_width = width >> level > 0 ? width >> level : 1;
+        int dst_height = height >> level > 0 ? height >> level : 1;
+        filter_level(src, src_width, src_height, dst, dst_width, dst_height, options->filter, options->thread_count);
+
+        int dst_pixels = dst_width * dst_height;
+        float alpha_scale = 1.0f;
+        if (options->alpha_cutoff > 0.0f) {
+            alpha_scale = alpha_coverage_scale(dst, dst_pixels, options->alpha_cutoff, target_coverage);
+        }
+        out_levels[level] = (uint8_t *)malloc((size_t)dst_pixels * 4);
+        quantize_level(dst, dst_pixels, options->srgb, alpha_scale, out_levels[level]);
+
+        float *swap = src;
+        src = dst;
+        dst = swap;
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    free(src);
+    free(dst);
+}
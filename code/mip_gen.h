@@ -0,0 +1,35 @@
+#ifndef MIP_GEN_H
+#define MIP_GEN_H
+
+#include <stdint.h>
+
+// CPU mip chain generation for RGBA8 images. Filtering runs in linear float,
+// separably, with each level split into bands of rows on the job system.
+enum Mip_Filter {
+    MIP_FILTER_BOX,     // 2x2 average on even sizes
+    MIP_FILTER_KAISER,  // windowed sinc, radius 3, alpha 4
+    MIP_FILTER_LANCZOS, // Lanczos 3
+    MIP_FILTER_COUNT
+};
+
+struct Mip_Options {
+    Mip_Filter filter;
+    bool srgb;          // rgb is sRGB encoded, filter it in linear space
+    float alpha_cutoff; // > 0 scales alpha so each level keeps the alpha test coverage of level 0
+    int thread_count;   // 1 stays on the calling thread, anything else uses the job system
+};
+
+const char *mip_filter_name(Mip_Filter filter);
+// Widest vector path of the vertical pass on this CPU: "avx2", "sse2" or "scalar"
+const char *mip_simd_name();
+int mip_level_count(int width, int height);
+
+// Fills out_levels[1..level_count-1] with malloc'd RGBA8 levels made from
+// rgba, level i being max(1, width >> i) by max(1, height >> i).
+// out_levels[0] is left untouched.
+void mip_generate(const uint8_t *rgba, int width, int height, int level_count, const Mip_Options *options, uint8_t **out_levels);
+
+// Resizes to any size with the same filter, e.g. to round up to a power of two
+void mip_resample(const uint8_t *rgba, int width, int height, uint8_t *out, int out_width, int out_height, const Mip_Options *options);
+
+#endif // MIP_GEN_H
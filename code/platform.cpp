@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "platform.h"
+
+// chunk size when a file is streamed into a copy
+#define PLATFORM_STREAM_CHUNK (1024 * 1024)
+
+// Reads the whole file in chunks into a heap copy
+static bool platform_copy_file(const char *path, Platform_Mapped_File *out_file) {
+    Platform_File_Stream stream;
+    if (!platform_stream_open(path, &stream)) return false;
+    if (stream.size == 0) {
+        platform_stream_close(&stream);
+        return false;
+    }
+    uint8_t *data = (uint8_t *)malloc((size_t)stream.size);
+    int64_t offset = 0;
+    while (data && offset < stream.size) {
+        int64_t chunk = stream.size - offset < PLATFORM_STREAM_CHUNK ? stream.size - offset : PLATFORM_STREAM_CHUNK;
+        int64_t read = platform_stream_read(&stream, data + offset, chunk);
+        if (read <= 0) break;
+        offset += read;
+    }
+    platform_stream_close(&stream);
+    if (!data || offset != stream.size) {
+        free(data);
+        return false;
+    }
+    out_file->data = data;
+    out_file->size = stream.size;
+    out_file->copied = true;
+    return true;
+}
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+
+bool platform_map_file(const char *path, Platform_Mapped_File *out_file) {
+    *out_file = {};
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return platform_copy_file(path, out_file);
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        return platform_copy_file(path, out_file);
+    }
+    out_file->data = data;
+    out_file->size = size.QuadPart;
+    out_file->handle = mapping;
+    return true;
+}
+
+void platform_unmap_file(Platform_Mapped_File *file) {
+    if (file->copied) {
+        free(file->data);
+    } else {
+        if (file->data) UnmapViewOfFile(file->data);
+        if (file->handle) CloseHandle((HANDLE)file->handle);
+    }
+    *file = {};
+}
+
+void platform_advise(Platform_Mapped_File *file, int64_t offset, int64_t size, Platform_Access access) {
+    if (file->copied || !file->data || offset >= file->size) return;
+    if (size <= 0 || offset + size > file->size) size = file->size - offset;
+    // mapped views only take a prefetch; read ahead follows the file handle flags
+    if (access == PLATFORM_ACCESS_WILLNEED) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = (uint8_t *)file->data + offset;
+        range.NumberOfBytes = (SIZE_T)size;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+bool platform_stream_open(const char *path, Platform_File_Stream *out_stream) {
+    *out_stream = {};
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    out_stream->handle = file;
+    out_stream->size = size.QuadPart;
+    return true;
+}
+
+int64_t platform_stream_read(Platform_File_Stream *stream, void *buffer, int64_t size) {
+    int64_t total = 0;
+    while (total < size) {
+        DWORD chunk = size - total > 0x40000000 ? 0x40000000 : (DWORD)(size - total);
+        DWORD read = 0;
+        if (!ReadFile((HANDLE)stream->handle, (uint8_t *)buffer + total, chunk, &read, NULL)) return -1;
+        if (read == 0) break;
+        total += read;
+    }
+    return total;
+}
+
+int64_t platform_stream_read_at(Platform_File_Stream *stream, void *buffer, int64_t size, int64_t offset) {
+    int64_t total = 0;
+    while (total < size) {
+        DWORD chunk = size - total > 0x40000000 ? 0x40000000 : (DWORD)(size - total);
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset + total);
+        overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+        DWORD read = 0;
+        if (!ReadFile((HANDLE)stream->handle, (uint8_t *)buffer + total, chunk, &read, &overlapped)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) break;
+            return -1;
+        }
+        if (read == 0) break;
+        total += read;
+    }
+    return total;
+}
+
+void platform_stream_close(Platform_File_Stream *stream) {
+    if (stream->handle) CloseHandle((HANDLE)stream->handle);
+    *stream = {};
+}
+
+void *platform_reserve(size_t size) {
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool platform_commit(void *address, size_t size) {
+    return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void platform_release(void *address, size_t size) {
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+
+bool platform_pin_thread(int core) {
+    if (core < 0 || core >= 64) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+}
+
+bool platform_list_files(const char *directory, bool recursive, Platform_File_Proc proc, void *data) {
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s/*", directory);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find == INVALID_HANDLE_VALUE) return false;
+    do {
+        const char *name = found.cFileName;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", directory, name);
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (recursive) platform_list_files(path, true, proc, data);
+        } else {
+            proc(path, data);
+        }
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+    return true;
+}
+
+int64_t platform_file_mtime(const char *path) {
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) return -1;
+    return (int64_t)st.st_mtime;
+}
+
+bool platform_make_directory(const char *path) {
+    return _mkdir(path) == 0 || errno == EEXIST;
+}
+
+bool platform_replace_file(const char *src, const char *dst) {
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+bool platform_map_file(const char *path, Platform_Mapped_File *out_file) {
+    *out_file = {};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return platform_copy_file(path, out_file);
+
+    out_file->data = data;
+    out_file->size = (int64_t)st.st_size;
+    return true;
+}
+
+void platform_unmap_file(Platform_Mapped_File *file) {
+    if (file->copied) {
+        free(file->data);
+    } else if (file->data) {
+        munmap(file->data, (size_t)file->size);
+    }
+    *file = {};
+}
+
+void platform_advise(Platform_Mapped_File *file, int64_t offset, int64_t size, Platform_Access access) {
+    if (file->copied || !file->data || offset >= file->size) return;
+    if (size <= 0 || offset + size > file->size) size = file->size - offset;
+    // madvise wants a page aligned start
+    int64_t page = (int64_t)sysconf(_SC_PAGESIZE);
+    int64_t start = offset / page * page;
+    size += offset - start;
+    int advice = MADV_NORMAL;
+    switch (access) {
+    case PLATFORM_ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+    case PLATFORM_ACCESS_RANDOM: advice = MADV_RANDOM; break;
+    case PLATFORM_ACCESS_WILLNEED: advice = MADV_WILLNEED; break;
+    case PLATFORM_ACCESS_DONTNEED: advice = MADV_DONTNEED; break;
+    default: break;
+    }
+    madvise((uint8_t *)file->data + start, (size_t)size, advice);
+}
+
+bool platform_stream_open(const char *path, Platform_File_Stream *out_stream) {
+    *out_stream = {};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    out_stream->handle = (void *)(intptr_t)(fd + 1);
+    out_stream->size = (int64_t)st.st_size;
+    return true;
+}
+
+int64_t platform_stream_read(Platform_File_Stream *stream, void *buffer, int64_t size) {
+    int fd = (int)(intptr_t)stream->handle - 1;
+    int64_t total = 0;
+    while (total < size) {
+        ssize_t result = read(fd, (uint8_t *)buffer + total, (size_t)(size - total));
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (result == 0) break;
+        total += result;
+    }
+    return total;
+}
+
+int64_t platform_stream_read_at(Platform_File_Stream *stream, void *buffer, int64_t size, int64_t offset) {
+    int fd = (int)(intptr_t)stream->handle - 1;
+    int64_t total = 0;
+    while (total < size) {
+        ssize_t result = pread(fd, (uint8_t *)buffer + total, (size_t)(size - total), (off_t)(offset + total));
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (result == 0) break;
+        total += result;
+    }
+    return total;
+}
+
+void platform_stream_close(Platform_File_Stream *stream) {
+    if (stream->handle) close((int)(intptr_t)stream->handle - 1);
+    *stream = {};
+}
+
+void *platform_reserve(size_t size) {
+    void *address = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return address == MAP_FAILED ? NULL : address;
+}
+
+bool platform_commit(void *address, size_t size) {
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void platform_release(void *address, size_t size) {
+    munmap(address, size);
+}
+
+bool platform_pin_thread(int core) {
+#ifdef __linux__
+    if (core < 0 || core >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool platform_list_files(const char *directory, bool recursive, Platform_File_Proc proc, void *data) {
+    DIR *dir = opendir(directory);
+    if (!dir) return false;
+    while (struct dirent *found = readdir(dir)) {
+        const char *name = found->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", directory, name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (recursive) platform_list_files(path, true, proc, data);
+        } else if (S_ISREG(st.st_mode)) {
+            proc(path, data);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+int64_t platform_file_mtime(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    return (int64_t)st.st_mtime;
+}
+
+bool platform_make_directory(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool platform_replace_file(const char *src, const char *dst) {
+    return rename(src, dst) == 0;
+}
+
+#endif
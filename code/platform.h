@@ -0,0 +1,68 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Read-only view of a whole file. Normally a memory mapping, so loaders run
+// straight on the page cache with no copies. When a file cannot be mapped it
+// is streamed into a heap copy instead, and callers see the same view.
+struct Platform_Mapped_File {
+    void *data;
+    int64_t size;
+    void *handle; // file mapping object on win32
+    bool copied;  // data is a heap copy, not a mapping
+};
+
+// How a range of a view will be read, so the OS can read ahead or not
+enum Platform_Access {
+    PLATFORM_ACCESS_NORMAL,
+    PLATFORM_ACCESS_SEQUENTIAL, // front to back, read ahead aggressively
+    PLATFORM_ACCESS_RANDOM,     // scattered reads, no read ahead
+    PLATFORM_ACCESS_WILLNEED,   // start reading the range in now
+    PLATFORM_ACCESS_DONTNEED,   // done with the range for now
+};
+
+bool platform_map_file(const char *path, Platform_Mapped_File *out_file);
+// Unmaps the view or frees the copy; data is invalid afterwards
+void platform_unmap_file(Platform_Mapped_File *file);
+// Hint for size bytes from offset, 0 meaning to the end. Ignored for copies
+// and where the OS has no equivalent.
+void platform_advise(Platform_Mapped_File *file, int64_t offset, int64_t size, Platform_Access access);
+
+// Sequential reads into the caller's buffer, for files read once front to
+// back and as the fallback when mapping fails
+struct Platform_File_Stream {
+    void *handle; // HANDLE on win32, file descriptor + 1 elsewhere
+    int64_t size;
+};
+
+bool platform_stream_open(const char *path, Platform_File_Stream *out_stream);
+// Fills buffer unless the file ends first. Returns the bytes read, 0 at the
+// end of the file and -1 on error.
+int64_t platform_stream_read(Platform_File_Stream *stream, void *buffer, int64_t size);
+// Same at an offset, whatever the stream position, so several threads can
+// read one stream at once. Do not mix with platform_stream_read.
+int64_t platform_stream_read_at(Platform_File_Stream *stream, void *buffer, int64_t size, int64_t offset);
+void platform_stream_close(Platform_File_Stream *stream);
+
+// Address space with no memory behind it until committed, in page multiples
+void *platform_reserve(size_t size);
+bool platform_commit(void *address, size_t size);
+void platform_release(void *address, size_t size);
+
+// Keeps the calling thread on one core. False where it is not supported.
+bool platform_pin_thread(int core);
+
+typedef void (*Platform_File_Proc)(const char *path, void *data);
+// Calls proc with "directory/name" for each file in directory, and with
+// recursive set for each file below it. Returns false if it cannot be read.
+bool platform_list_files(const char *directory, bool recursive, Platform_File_Proc proc, void *data);
+
+// Last modification time, -1 if the file does not exist
+int64_t platform_file_mtime(const char *path);
+bool platform_make_directory(const char *path);
+// Atomically replaces dst with src
+bool platform_replace_file(const char *src, const char *dst);
+
+#endif // PLATFORM_H
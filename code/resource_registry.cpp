@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <stb_ds.h>
+
+#include "resource_registry.h"
+
+void resource_registry_init(Resource_Registry *registry) {
+    *registry = {};
+    sh_new_strdup(registry->lookup);
+}
+
+void resource_registry_free(Resource_Registry *registry) {
+    for (int i = 0; i < arrlen(registry->entries); i++) {
+        free(registry->entries[i].key);
+    }
+    arrfree(registry->entries);
+    arrfree(registry->free_slots);
+    shfree(registry->lookup);
+    *registry = {};
+}
+
+static Resource_Entry *resource_entry(Resource_Registry *registry, Resource_Handle handle) {
+    if (handle.index >= (uint32_t)arrlen(registry->entries)) return NULL;
+    Resource_Entry *entry = &registry->entries[handle.index];
+    return entry->generation == handle.generation && entry->key ? entry : NULL;
+}
+
+bool resource_acquire(Resource_Registry *registry, const char *key, Resource_Handle *out_handle) {
+    ptrdiff_t found = shgeti(registry->lookup, key);
+    if (found >= 0) {
+        uint32_t index = registry->lookup[found].value;
+        Resource_Entry *entry = &registry->entries[index];
+        entry->ref_count++;
+        *out_handle = {index, entry->generation};
+        return false;
+    }
+
+    uint32_t index;
+    if (arrlen(registry->free_slots) > 0) {
+        index = arrpop(registry->free_slots);
+    } else {
+        Resource_Entry empty = {};
+        index = (uint32_t)arrlen(registry->entries);
+        arrput(registry->entries, empty);
+    }
+    Resource_Entry *entry = &registry->entries[index];
+    size_t key_size = strlen(key) + 1;
+    entry->key = (char *)malloc(key_size);
+    memcpy(entry->key, key, key_size);
+    entry->generation++;
+    entry->ref_count = 1;
+    shput(registry->lookup, key, index);
+    *out_handle = {index, entry->generation};
+    return true;
+}
+
+void resource_retain(Resource_Registry *registry, Resource_Handle handle) {
+    if (!resource_valid(registry, handle)) return;
+    registry->entries[handle.index].ref_count++;
+}
+
+bool resource_release(Resource_Registry *registry, Resource_Handle handle) {
+    if (!resource_valid(registry, handle)) return false;
+    Resource_Entry *entry = &registry->entries[handle.index];
+    entry->ref_count--;
+    return entry->ref_count == 0;
+}
+
+void resource_remove(Resource_Registry *registry, Resource_Handle handle) {
+    Resource_Entry *entry = resource_entry(registry, handle);
+    assert(entry && entry->ref_count == 0);
+    shdel(registry->lookup, entry->key);
+    free(entry->key);
+    entry->key = NULL;
+    // bump again so handles from before the removal never match a reuse
+    entry->generation++;
+    arrput(registry->free_slots, handle.index);
+}
+
+bool resource_valid(Resource_Registry *registry, Resource_Handle handle) {
+    Resource_Entry *entry = resource_entry(registry, handle);
+    return entry && entry->ref_count > 0;
+}
+
+int resource_ref_count(Resource_Registry *registry, Resource_Handle handle) {
+    Resource_Entry *entry = resource_entry(registry, handle);
+    return entry ? entry->ref_count : 0;
+}
+
+void resource_normalize_path(const char *path, char *out_path, int out_size) {
+    assert(out_size > 0);
+    int n = 0;
+    const char *c = path;
+    bool absolute = *c == '/' || *c == '\\';
+    if (absolute && n < out_size - 1) out_path[n++] = '/';
+    int root = n;
+
+    while (*c) {
+        while (*c == '/' || *c == '\\') c++;
+        const char *start = c;
+        while (*c && *c != '/' && *c != '\\') c++;
+        int length = (int)(c - start);
+        if (length == 0 || (length == 1 && start[0] == '.')) continue;
+
+        bool parent = length == 2 && start[0] == '.' && start[1] == '.';
+        if (parent && n > root) {
+            // the last segment written starts after the last separator
+            int last = n;
+            while (last > root && out_path[last - 1] != '/') last--;
+            bool last_is_parent = n - last == 2 && out_path[last] == '.' && out_path[last + 1] == '.';
+            if (!last_is_parent) {
+                n = last;
+                if (n > root) n--; // drop the separator before it
+                continue;
+            }
+        }
+
+        if (n > root && n < out_size - 1) out_path[n++] = '/';
+        for (int i = 0; i < length && n < out_size - 1; i++) {
+            out_path[n++] = start[i];
+        }
+    }
+    out_path[n] = '\0';
+}
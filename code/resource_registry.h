@@ -0,0 +1,57 @@
+#ifndef RESOURCE_REGISTRY_H
+#define RESOURCE_REGISTRY_H
+
+#include <stdint.h>
+
+// Deduplicates loaded resources by key and counts their users. Handles carry
+// the generation of their slot, so a handle to a removed resource stays
+// invalid after the slot is reused. The registry only tracks slots; the
+// owner keeps the payload in its own array indexed by the slot.
+
+#define RESOURCE_KEY_SIZE 2048
+
+struct Resource_Handle {
+    uint32_t index;
+    uint32_t generation; // 0 is never valid
+};
+
+struct Resource_Entry {
+    char *key;
+    uint32_t generation;
+    int ref_count;
+};
+
+struct Resource_Lookup {
+    char *key;
+    uint32_t value;
+};
+
+struct Resource_Registry {
+    Resource_Entry *entries;   // stb_ds array
+    uint32_t *free_slots;      // stb_ds array
+    Resource_Lookup *lookup;   // stb_ds string hash map
+};
+
+void resource_registry_init(Resource_Registry *registry);
+void resource_registry_free(Resource_Registry *registry);
+
+// Returns true when the key was not registered yet and the caller has to
+// load it. Either way the handle gains a reference.
+bool resource_acquire(Resource_Registry *registry, const char *key, Resource_Handle *out_handle);
+// Both do nothing for a stale handle, one whose references are all dropped
+// or whose slot was reused.
+void resource_retain(Resource_Registry *registry, Resource_Handle handle);
+// Returns true when the last reference was dropped. The caller frees the
+// payload, then calls resource_remove, unless it is acquired again first.
+bool resource_release(Resource_Registry *registry, Resource_Handle handle);
+void resource_remove(Resource_Registry *registry, Resource_Handle handle);
+
+bool resource_valid(Resource_Registry *registry, Resource_Handle handle);
+int resource_ref_count(Resource_Registry *registry, Resource_Handle handle);
+
+// Forward slashes, no "." or empty segments, "dir/.." folded away. Case is
+// kept, so keys are case-sensitive on every platform, Windows included, and
+// "Tex.png" and "tex.png" load twice there.
+void resource_normalize_path(const char *path, char *out_path, int out_size);
+
+#endif // RESOURCE_REGISTRY_H
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <assert.h>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include "startup.h"
+#include "job_system.h"
+
+// width of the bars in the printed timeline
+#define STARTUP_TIMELINE_WIDTH 40
+
+struct Startup_Task {
+    const char *name;
+    Startup_Thread thread;
+    Startup_Proc proc;
+    void *data;
+    int dependents[STARTUP_MAX_DEPENDENTS];
+    int dependent_count;
+    int waiting; // unfinished dependencies
+    bool skipped;
+    bool failed;
+    double start_ms;
+    double end_ms;
+};
+
+struct Startup_Mark {
+    const char *name;
+    double ms;
+};
+
+// taken during static initialization, as close to process start as we get
+static const std::chrono::steady_clock::time_point startup_epoch = std::chrono::steady_clock::now();
+
+static std::mutex startup_mutex;
+static std::condition_variable startup_cv;
+static Startup_Task startup_tasks[STARTUP_MAX_TASKS];
+static int startup_task_count;
+static int startup_finished;
+static bool startup_any_failed;
+// main tasks whose dependencies are done, run in this order
+static int startup_main_ready[STARTUP_MAX_TASKS];
+static int startup_main_head;
+static int startup_main_tail;
+
+static Startup_Mark startup_marks[STARTUP_MAX_MARKS];
+static int startup_mark_count;
+static bool startup_reported;
+
+double startup_time_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_epoch).count();
+}
+
+int startup_task(const char *name, Startup_Thread thread, Startup_Proc proc, void *data) {
+    assert(startup_task_count < STARTUP_MAX_TASKS);
+    int index = startup_task_count++;
+    Startup_Task *task = &startup_tasks[index];
+    *task = {};
+    task->name = name;
+    task->thread = thread;
+    task->proc = proc;
+    task->data = data;
+    return index;
+}
+
+void startup_depends(int task, int dependency) {
+    Startup_Task *from = &startup_tasks[dependency];
+    assert(task > dependency && "add tasks after what they depend on");
+    assert(from->dependent_count < STARTUP_MAX_DEPENDENTS);
+    from->dependents[from->dependent_count++] = task;
+    startup_tasks[task].waiting++;
+}
+
+static void startup_worker(void *data);
+
+// Called with the mutex held once every dependency of index is done
+static void startup_ready(int index);
+
+static void startup_finish(int index, bool ok) {
+    Startup_Task *task = &startup_tasks[index];
+    task->failed = !ok;
+    if (!ok) startup_any_failed = true;
+    startup_finished++;
+    for (int i = 0; i < task->dependent_count; i++) {
+        Startup_Task *dependent = &startup_tasks[task->dependents[i]];
+        if (!ok) dependent->skipped = true;
+        if (--dependent->waiting == 0) startup_ready(task->dependents[i]);
+    }
+    startup_cv.notify_all();
+}
+
+static void startup_ready(int index) {
+    Startup_Task *task = &startup_tasks[index];
+    if (task->skipped) {
+        printf("Startup: skipping %s\n", task->name);
+        task->start_ms = task->end_ms = startup_time_ms();
+        startup_finish(index, false);
+    } else if (task->thread == STARTUP_WORKER) {
+        job_run(startup_worker, (void *)(intptr_t)index, NULL);
+    } else {
+        startup_main_ready[startup_main_tail++] = index;
+    }
+}
+
+static bool startup_execute(Startup_Task *task) {
+    task->start_ms = startup_time_ms();
+    bool ok = task->proc(task->data);
+    task->end_ms = startup_time_ms();
+    return ok;
+}
+
+static void startup_worker(void *data) {
+    int index = (int)(intptr_t)data;
+    bool ok = startup_execute(&startup_tasks[index]);
+    std::lock_guard<std::mutex> lock(startup_mutex);
+    startup_finish(index, ok);
+}
+
+bool startup_run() {
+    std::unique_lock<std::mutex> lock(startup_mutex);
+    for (int i = 0; i < startup_task_count; i++) {
+        if (startup_tasks[i].waiting == 0) startup_ready(i);
+    }
+    while (startup_finished < startup_task_count) {
+        startup_cv.wait(lock, [] { return startup_main_head < startup_main_tail || startup_finished == startup_task_count; });
+        while (startup_main_head < startup_main_tail) {
+            int index = startup_main_ready[startup_main_head++];
+            lock.unlock();
+            bool ok = startup_execute(&startup_tasks[index]);
+            lock.lock();
+            startup_finish(index, ok);
+        }
+    }
+    return !startup_any_failed;
+}
+
+double startup_mark(const char *name) {
+    double ms = startup_time_ms();
+    if (startup_mark_count < STARTUP_MAX_MARKS) {
+        startup_marks[startup_mark_count++] = {name, ms};
+    }
+    return ms;
+}
+
+void startup_report() {
+    if (startup_reported) return;
+    startup_reported = true;
+
+    double end = 0.0;
+    for (int i = 0; i < startup_task_count; i++) {
+        if (startup_tasks[i].end_ms > end) end = startup_tasks[i].end_ms;
+    }
+    for (int i = 0; i < startup_mark_count; i++) {
+        if (startup_marks[i].ms > end) end = startup_marks[i].ms;
+    }
+    double scale = end > 0.0 ? STARTUP_TIMELINE_WIDTH / end : 0.0;
+
+    printf("Startup timeline, ms from process start:\n");
+    for (int i = 0; i < startup_task_count; i++) {
+        Startup_Task *task = &startup_tasks[i];
+        char bar[STARTUP_TIMELINE_WIDTH + 1];
+        int from = (int)(task->start_ms * scale);
+        int to = (int)(task->end_ms * scale);
+        for (int c = 0; c < STARTUP_TIMELINE_WIDTH; c++) {
+            bar[c] = c >= from && (c < to || c == from) ? '#' : '.';
+        }
+        bar[STARTUP_TIMELINE_WIDTH] = 0;
+        printf("  %-24s %-6s %8.1f %8.1f  %s%s\n", task->name, task->thread == STARTUP_MAIN ? "main" : "worker",
+               task->start_ms, task->end_ms, bar, task->skipped ? " skipped" : task->failed ? " failed" : "");
+    }
+    for (int i = 0; i < startup_mark_count; i++) {
+        printf("  %-24s %-6s %8.1f\n", startup_marks[i].name, "", startup_marks[i].ms);
+    }
+
+    // one row per task and mark, tagged with the time of the run
+    FILE *fp = fopen(STARTUP_LOG_PATH, "ab");
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) fprintf(fp, "run,name,thread,start_ms,end_ms\n");
+    long long run = (long long)time(NULL);
+    for (int i = 0; i < startup_task_count; i++) {
+        Startup_Task *task = &startup_tasks[i];
+        fprintf(fp, "%lld,%s,%s,%.2f,%.2f\n", run, task->name, task->thread == STARTUP_MAIN ? "main" : "worker",
+                task->start_ms, task->end_ms);
+    }
+    for (int i = 0; i < startup_mark_count; i++) {
+        fprintf(fp, "%lld,%s,,%.2f,%.2f\n", run, startup_marks[i].name, startup_marks[i].ms, startup_marks[i].ms);
+    }
+    fclose(fp);
+}
@@ -0,0 +1,41 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+// Startup as a graph of tasks. Worker tasks run on the job system as soon as
+// everything they depend on has finished; main tasks run on the thread that
+// calls startup_run, the one with the GL context, in the order they become
+// ready. So file reads, decoding and mesh building overlap window creation
+// and each other, and GL objects are created as their inputs arrive.
+//
+// Every task is timed from process start, along with points like the first
+// frame. startup_report prints the timeline and appends it to
+// STARTUP_LOG_PATH, so time to first frame can be compared across runs.
+
+#define STARTUP_MAX_TASKS 64
+#define STARTUP_MAX_DEPENDENTS 16
+#define STARTUP_MAX_MARKS 8
+#define STARTUP_LOG_PATH "startup_times.csv"
+
+// Returns false on failure; tasks that depend on it are skipped
+typedef bool (*Startup_Proc)(void *data);
+
+enum Startup_Thread {
+    STARTUP_WORKER,
+    STARTUP_MAIN,
+};
+
+int startup_task(const char *name, Startup_Thread thread, Startup_Proc proc, void *data);
+// task does not start before dependency has finished
+void startup_depends(int task, int dependency);
+// Runs the graph to the end, the job system must be running. False if any
+// task failed or was skipped.
+bool startup_run();
+
+// Milliseconds since the process started
+double startup_time_ms();
+// Records a point on the timeline and returns its time
+double startup_mark(const char *name);
+// Once; later calls do nothing
+void startup_report();
+
+#endif // STARTUP_H
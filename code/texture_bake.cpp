@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+
+#include <glad/glad.h>
+
+#include "texture_bake.h"
+#include "platform.h"
+#include "image_decode.h"
+#include "asset_pack.h"
+#include "memory_arena.h"
+#include "job_system.h"
+
+Bc_Quality texture_bake_quality = BC_QUALITY_NORMAL;
+Mip_Filter texture_bake_filter = MIP_FILTER_KAISER;
+
+static const uint8_t BAKED_TEXTURE_IDENTIFIER[12] = {0xAB, 'G', 'L', 'T', 'E', 'X', ' ', '1', 0xBB, '\r', '\n', 0x1A};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int baked_texture_level_width(const Baked_Texture_Header *header, int level) {
+    int width = (int)header->width >> level;
+    return width > 0 ? width : 1;
+}
+
+int baked_texture_level_height(const Baked_Texture_Header *header, int level) {
+    int height = (int)header->height >> level;
+    return height > 0 ? height : 1;
+}
+
+int gl_format_bytes_per_pixel(uint32_t format, uint32_t type) {
+    int channels = 0;
+    switch (format) {
+    case GL_RED: channels = 1; break;
+    case GL_RG: channels = 2; break;
+    case GL_RGB: channels = 3; break;
+    case GL_RGBA: channels = 4; break;
+    }
+    return type == GL_UNSIGNED_BYTE ? channels : 0;
+}
+
+uint32_t gl_storage_format(uint32_t internal_format) {
+    if (TEXTURE_SAMPLE_LINEAR) return internal_format;
+    switch (internal_format) {
+    case GL_SRGB8: return GL_RGB8;
+    case GL_SRGB8_ALPHA8: return GL_RGBA8;
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return internal_format;
+    }
+}
+
+void baked_texture_rows(const Baked_Texture_Header *header, int level, int *out_row_size, int *out_row_count, int *out_row_height) {
+    int width = baked_texture_level_width(header, level);
+    int height = baked_texture_level_height(header, level);
+    int block_bytes = bc_block_bytes_for_gl_format(header->gl_internal_format);
+    if (block_bytes) {
+        *out_row_size = (width + 3) / 4 * block_bytes;
+        *out_row_count = (height + 3) / 4;
+        *out_row_height = 4;
+    } else {
+        *out_row_size = width * gl_format_bytes_per_pixel(header->gl_format, header->gl_type);
+        *out_row_count = height;
+        *out_row_height = 1;
+    }
+}
+
+bool baked_texture_parse(const void *data, int64_t size, Baked_Texture *out_baked) {
+    *out_baked = {};
+    if (size < (int64_t)sizeof(Baked_Texture_Header)) return false;
+
+    const Baked_Texture_Header *header = (const Baked_Texture_Header *)data;
+    if (memcmp(header->identifier, BAKED_TEXTURE_IDENTIFIER, sizeof(header->identifier)) != 0) return false;
+    if (header->version != BAKED_TEXTURE_VERSION) return false;
+    if (header->face_count == 0 || header->level_count == 0 || header->level_count > 16) return false;
+
+    int64_t index_end = sizeof(Baked_Texture_Header) + header->level_count * sizeof(Baked_Level);
+    if (size < index_end) return false;
+    const Baked_Level *levels = (const Baked_Level *)(header + 1);
+    for (uint32_t i = 0; i < header->level_count; i++) {
+        if (levels[i].offset + levels[i].size > (uint64_t)size) return false;
+    }
+
+    out_baked->header = header;
+    out_baked->levels = levels;
+    out_baked->file = (const uint8_t *)data;
+    return true;
+}
+
+const uint8_t *baked_texture_face(Baked_Texture *baked, int level, int face, int64_t *out_size) {
+    const Baked_Level *entry = &baked->levels[level];
+    int64_t face_size = (int64_t)(entry->size / baked->header->face_count);
+    if (out_size) *out_size = face_size;
+    return baked->file + entry->offset + face * face_size;
+}
+
+static bool files_equal(const char *a, const char *b) {
+    Platform_Mapped_File file_a, file_b;
+    if (!platform_map_file(a, &file_a)) return false;
+    if (!platform_map_file(b, &file_b)) {
+        platform_unmap_file(&file_a);
+        return false;
+    }
+    bool equal = file_a.size == file_b.size && memcmp(file_a.data, file_b.data, (size_t)file_a.size) == 0;
+    platform_unmap_file(&file_a);
+    platform_unmap_file(&file_b);
+    return equal;
+}
+
+// Layers or textures that share a source bake the same file on several
+// workers at once, so every write gets its own temp file
+static std::atomic<uint32_t> bake_write_counter;
+
+bool baked_texture_write(const char *path, Baked_Texture_Header *header, const void **levels, const uint64_t *level_sizes) {
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.%u.tmp", path, bake_write_counter.fetch_add(1, std::memory_order_relaxed));
+    FILE *fp = fopen(temp_path, "wb");
+    if (fp == NULL) {
+        printf("Error opening file: %s\n", temp_path);
+        return false;
+    }
+
+    memcpy(header->identifier, BAKED_TEXTURE_IDENTIFIER, sizeof(header->identifier));
+    header->version = BAKED_TEXTURE_VERSION;
+
+    Baked_Level index[16];
+    assert(header->level_count <= 16);
+    uint64_t offset = align_up(sizeof(Baked_Texture_Header) + header->level_count * sizeof(Baked_Level), BAKED_TEXTURE_ALIGNMENT);
+    for (uint32_t i = 0; i < header->level_count; i++) {
+        index[i].offset = offset;
+        index[i].size = level_sizes[i];
+        offset = align_up(offset + level_sizes[i], BAKED_TEXTURE_ALIGNMENT);
+    }
+
+    static const uint8_t zeros[BAKED_TEXTURE_ALIGNMENT] = {};
+    bool ok = fwrite(header, sizeof(*header), 1, fp) == 1;
+    ok = ok && fwrite(index, sizeof(Baked_Level), header->level_count, fp) == header->level_count;
+    uint64_t written = sizeof(Baked_Texture_Header) + header->level_count * sizeof(Baked_Level);
+    for (uint32_t i = 0; ok && i < header->level_count; i++) {
+        size_t padding = (size_t)(index[i].offset - written);
+        ok = ok && (padding == 0 || fwrite(zeros, 1, padding, fp) == padding);
+        ok = ok && fwrite(levels[i], 1, (size_t)level_sizes[i], fp) == level_sizes[i];
+        written = index[i].offset + level_sizes[i];
+    }
+    ok = (fclose(fp) == 0) && ok;
+
+    bool replaced = ok && platform_replace_file(temp_path, path);
+    // the replace fails on Windows while another worker has its identical
+    // bake mapped, which is as good as winning
+    if (ok && !replaced) replaced = files_equal(temp_path, path);
+    if (!replaced) {
+        printf("Failed to write baked texture: %s\n", path);
+    }
+    remove(temp_path);
+    return replaced;
+}
+
+static int append_flattened(char *out_path, int n, int out_size, const char *path) {
+    for (const char *c = path; *c && n < out_size - 1; c++) {
+        out_path[n++] = (*c == '/' || *c == '\\' || *c == ':') ? '_' : *c;
+    }
+    out_path[n] = '\0';
+    return n;
+}
+
+void texture_bake_path(const char *source, const char *alpha_source, uint32_t flags, char *out_path, int out_size) {
+    int n = snprintf(out_path, out_size, "%s/", BAKED_TEXTURE_DIRECTORY);
+    n = append_flattened(out_path, n, out_size, source);
+    if (alpha_source && n < out_size - 1) {
+        out_path[n++] = '+';
+        n = append_flattened(out_path, n, out_size, alpha_source);
+    }
+    // the same source baked with other flags, e.g. as a 2D texture and as an
+    // array layer, gets its own file instead of rebaking over the other
+    snprintf(out_path + n, out_size - n, ".%x.gltex", flags);
+}
+
+// Uncompressed format for the bake flags and source channel count
+static void bake_pixel_format(uint32_t flags, int source_channels, Baked_Texture_Header *header) {
+    bool srgb = (flags & BAKE_SRGB) != 0;
+    header->gl_type = GL_UNSIGNED_BYTE;
+    if (flags & BAKE_CHANNELS_R) {
+        header->gl_internal_format = GL_R8;
+        header->gl_format = GL_RED;
+    } else if (flags & BAKE_CHANNELS_RG) {
+        header->gl_internal_format = GL_RG8;
+        header->gl_format = GL_RG;
+    } else if (source_channels == 2 || source_channels == 4) {
+        header->gl_internal_format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        header->gl_format = GL_RGBA;
+    } else {
+        header->gl_internal_format = srgb ? GL_SRGB8 : GL_RGB8;
+        header->gl_format = GL_RGB;
+    }
+}
+
+// Drops channels in place, RGBA8 to the first channels of each pixel
+static void pack_channels(uint8_t *rgba, int pixel_count, int channels) {
+    for (int i = 0; i < pixel_count; i++) {
+        for (int c = 0; c < channels; c++) {
+            rgba[i * channels + c] = rgba[i * 4 + c];
+        }
+    }
+}
+
+static int next_pow2(int value) {
+    int pow2 = 1;
+    while (pow2 < value) pow2 <<= 1;
+    return pow2;
+}
+
+// Copies the red channel of alpha_source into the alpha of pixels, resampling
+// it first when the sizes differ
+static bool pack_alpha(uint8_t *pixels, int width, int height, const char *alpha_source) {
+    Arena *scratch = memory_thread_scratch();
+    Arena_Temp temp = arena_temp_begin(scratch);
+    int alpha_width, alpha_height, alpha_n;
+    uint8_t *alpha = image_load(alpha_source, &alpha_width, &alpha_height, &alpha_n, 4, false);
+    if (alpha == NULL) {
+        printf("Failed to load texture: %s\n", alpha_source);
+        return false;
+    }
+    const uint8_t *mask = alpha;
+    if (alpha_width != width || alpha_height != height) {
+        Mip_Options options{};
+        options.filter = texture_bake_filter;
+        uint8_t *resampled = ARENA_PUSH_ARRAY(scratch, uint8_t, (size_t)width * height * 4);
+        if (!resampled) {
+            printf("Out of scratch memory resampling %s\n", alpha_source);
+            arena_temp_end(temp);
+            return false;
+        }
+        mip_resample(alpha, alpha_width, alpha_height, resampled, width, height, &options);
+        mask = resampled;
+    }
+    for (int i = 0; i < width * height; i++) {
+        pixels[i * 4 + 3] = mask[i * 4];
+    }
+    arena_temp_end(temp);
+    return true;
+}
+
+// Generates the mips of pixels, then compresses or packs every level to the
+// format in header. levels[0] is pixels itself when not compressed, every
+// other level is malloc'd; free them with free_levels.
+static void bake_levels(uint8_t *pixels, Baked_Texture_Header *header, const void **levels, uint64_t *level_sizes) {
+    uint32_t flags = header->flags;
+    Mip_Options mip_options{};
+    mip_options.filter = texture_bake_filter;
+    mip_options.srgb = (flags & BAKE_SRGB) != 0;
+    mip_options.alpha_cutoff = (flags & BAKE_ALPHA_COVERAGE) ? TEXTURE_BAKE_ALPHA_CUTOFF : 0.0f;
+
+    assert(header->level_count <= 16);
+    uint8_t *mips[16] = {pixels};
+    mip_generate(pixels, header->width, header->height, header->level_count, &mip_options, mips);
+    for (uint32_t i = 0; i < header->level_count; i++) {
+        levels[i] = mips[i];
+    }
+
+    uint32_t compress = flags & BAKE_COMPRESS_MASK;
+    if (compress) {
+        Bc_Format format = compress == BAKE_COMPRESS_BC1 ? BC_FORMAT_BC1 :
+                           compress == BAKE_COMPRESS_BC4 ? BC_FORMAT_BC4 :
+                           compress == BAKE_COMPRESS_BC5 ? BC_FORMAT_BC5 : BC_FORMAT_BC7;
+        header->gl_internal_format = bc_gl_internal_format(format);
+        if (format == BC_FORMAT_BC7 && (flags & BAKE_SRGB)) {
+            header->gl_internal_format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        }
+        header->gl_format = 0;
+        header->gl_type = 0;
+        for (uint32_t i = 0; i < header->level_count; i++) {
+            int level_width = baked_texture_level_width(header, i);
+            int level_height = baked_texture_level_height(header, i);
+            uint64_t size = (uint64_t)bc_compressed_size(format, level_width, level_height);
+            uint8_t *blocks = (uint8_t *)malloc((size_t)size);
+            bc_compress(format, (const uint8_t *)levels[i], level_width, level_height, blocks, texture_bake_quality, 0);
+            if (i > 0) free((void *)levels[i]);
+            levels[i] = blocks;
+            level_sizes[i] = size;
+        }
+    } else {
+        int channels = gl_format_bytes_per_pixel(header->gl_format, header->gl_type);
+        for (uint32_t i = 0; i < header->level_count; i++) {
+            int pixel_count = baked_texture_level_width(header, i) * baked_texture_level_height(header, i);
+            pack_channels(mips[i], pixel_count, channels);
+            level_sizes[i] = (uint64_t)pixel_count * channels;
+        }
+    }
+}
+
+static void free_levels(const Baked_Texture_Header *header, const void **levels) {
+    bool compressed = header->gl_format == 0;
+    for (uint32_t i = compressed ? 0 : 1; i < header->level_count; i++) {
+        free((void *)levels[i]);
+    }
+}
+
+// The decoded and resampled images live in the thread's scratch arena and
+// all go back at the end; only the mip levels are malloc'd
+bool texture_bake(const char *source, const char *alpha_source, const char *baked_path, uint32_t flags) {
+    Arena *scratch = memory_thread_scratch();
+    Arena_Temp temp = arena_temp_begin(scratch);
+    int width, height, n;
+    uint8_t *pixels = image_load(source, &width, &height, &n, 4, (flags & BAKE_FLIP_VERTICALLY) != 0);
+    if (pixels == NULL) {
+        printf("Failed to load texture: %s\n", source);
+        return false;
+    }
+    if (alpha_source) {
+        if (!pack_alpha(pixels, width, height, alpha_source)) {
+            arena_temp_end(temp);
+            return false;
+        }
+        n = 4;
+    }
+
+    Mip_Options mip_options{};
+    mip_options.filter = texture_bake_filter;
+    mip_options.srgb = (flags & BAKE_SRGB) != 0;
+    mip_options.alpha_cutoff = (flags & BAKE_ALPHA_COVERAGE) ? TEXTURE_BAKE_ALPHA_CUTOFF : 0.0f;
+
+    int pow2_width = next_pow2(width);
+    int pow2_height = next_pow2(height);
+    if ((flags & BAKE_RESIZE_POW2) && (pow2_width != width || pow2_height != height)) {
+        uint8_t *resampled = ARENA_PUSH_ARRAY(scratch, uint8_t, (size_t)pow2_width * pow2_height * 4);
+        if (!resampled) {
+            printf("Out of scratch memory resampling %s\n", source);
+            arena_temp_end(temp);
+            return false;
+        }
+        mip_resample(pixels, width, height, resampled, pow2_width, pow2_height, &mip_options);
+        pixels = resampled;
+        width = pow2_width;
+        height = pow2_height;
+    }
+
+    Baked_Texture_Header header{};
+    bake_pixel_format(flags, n, &header);
+    header.width = width;
+    header.height = height;
+    header.face_count = 1;
+    header.flags = flags;
+    header.level_count = mip_level_count(width, height);
+    const void *levels[16];
+    uint64_t level_sizes[16];
+    bake_levels(pixels, &header, levels, level_sizes);
+
+    platform_make_directory(BAKED_TEXTURE_DIRECTORY);
+    bool ok = baked_texture_write(baked_path, &header, levels, level_sizes);
+
+    free_levels(&header, levels);
+    arena_temp_end(temp);
+    if (ok) {
+        printf("Baked %s -> %s\n", source, baked_path);
+    }
+    return ok;
+}
+
+static bool baked_texture_is_current(const char *baked_path, uint32_t flags) {
+    Platform_Mapped_File file;
+    if (!platform_map_file(baked_path, &file)) return false;
+    Baked_Texture baked;
+    bool current = baked_texture_parse(file.data, file.size, &baked) && baked.header->flags == flags;
+    platform_unmap_file(&file);
+    return current;
+}
+
+bool texture_bake_ensure(const char *source, const char *alpha_source, uint32_t flags, char *out_path, int out_size) {
+    texture_bake_path(source, alpha_source, flags, out_path, out_size);
+    int64_t source_time = asset_mtime(source);
+    if (alpha_source && source_time >= 0) {
+        int64_t alpha_time = asset_mtime(alpha_source);
+        source_time = alpha_time < 0 || alpha_time > source_time ? alpha_time : source_time;
+    }
+    int64_t baked_time = platform_file_mtime(out_path);
+
+    if (baked_time >= 0 && baked_time >= source_time && baked_texture_is_current(out_path, flags)) {
+        return true;
+    }
+    if (source_time < 0) {
+        printf("Failed to load texture: %s\n", source);
+        return false;
+    }
+    return texture_bake(source, alpha_source, out_path, flags);
+}
+
+void texture_bake_cube_path(const char **faces, uint32_t flags, char *out_path, int out_size) {
+    // named after the first face, with a hash of all six so cube maps that
+    // share a face do not share a file
+    uint32_t hash = 2166136261u;
+    for (int f = 0; f < 6; f++) {
+        for (const char *c = faces[f]; *c; c++) {
+            hash = (hash ^ (uint8_t)*c) * 16777619u;
+        }
+        hash = (hash ^ '|') * 16777619u;
+    }
+    int n = snprintf(out_path, out_size, "%s/", BAKED_TEXTURE_DIRECTORY);
+    n = append_flattened(out_path, n, out_size, faces[0]);
+    snprintf(out_path + n, out_size - n, ".cube%08x.%x.gltex", hash, flags);
+}
+
+struct Cube_Face_Bake {
+    const char *path;
+    uint32_t flags;
+    uint8_t *pixels; // malloc'd, NULL if the decode failed
+    int width;
+    int height;
+    int channels;
+    Baked_Texture_Header header;
+    const void *levels[16];
+    uint64_t level_sizes[16];
+};
+
+static void decode_cube_faces(void *data, int begin, int end) {
+    Cube_Face_Bake *faces = (Cube_Face_Bake *)data;
+    for (int f = begin; f < end; f++) {
+        Cube_Face_Bake *face = &faces[f];
+        uint8_t *pixels = image_load(face->path, &face->width, &face->height, &face->channels, 4, (face->flags & BAKE_FLIP_VERTICALLY) != 0);
+        if (pixels == NULL) continue;
+        // moved out of the scratch of whichever thread ran this, which the job
+        // that thread was waiting in may reset
+        size_t size = (size_t)face->width * face->height * 4;
+        face->pixels = (uint8_t *)malloc(size);
+        memcpy(face->pixels, pixels, size);
+        image_free(pixels);
+    }
+}
+
+static void bake_cube_faces(void *data, int begin, int end) {
+    Cube_Face_Bake *faces = (Cube_Face_Bake *)data;
+    for (int f = begin; f < end; f++) {
+        bake_levels(faces[f].pixels, &faces[f].header, faces[f].levels, faces[f].level_sizes);
+    }
+}
+
+bool texture_bake_cube(const char **faces, const char *baked_path, uint32_t flags) {
+    // the faces decode and mip in parallel, then are gathered for the write
+    Cube_Face_Bake cube[6] = {};
+    for (int f = 0; f < 6; f++) {
+        cube[f].path = faces[f];
+        cube[f].flags = flags;
+    }
+    job_parallel_for(6, 1, decode_cube_faces, cube);
+
+    bool ok = true;
+    for (int f = 0; f < 6; f++) {
+        if (cube[f].pixels == NULL) {
+            printf("Failed to load texture: %s\n", faces[f]);
+            ok = false;
+        } else if (cube[f].width != cube[f].height || cube[f].width != cube[0].width) {
+            printf("Cube map face %s is not square or not the size of the others\n", faces[f]);
+            ok = false;
+        }
+    }
+
+    Baked_Texture_Header header{};
+    if (ok) {
+        // the format of face 0 for every face, even if another has alpha
+        bake_pixel_format(flags, cube[0].channels, &header);
+        header.width = cube[0].width;
+        header.height = cube[0].height;
+        header.face_count = 1; // while baking face by face
+        header.flags = flags;
+        header.level_count = mip_level_count(cube[0].width, cube[0].height);
+        for (int f = 0; f < 6; f++) {
+            cube[f].header = header;
+        }
+        job_parallel_for(6, 1, bake_cube_faces, cube);
+        header = cube[0].header;
+    }
+
+    Arena *scratch = memory_thread_scratch();
+    Arena_Temp temp = arena_temp_begin(scratch);
+    const void *cube_levels[16] = {};
+    uint64_t cube_sizes[16];
+    if (ok) {
+        // level data holds the faces back to back
+        for (uint32_t i = 0; i < header.level_count; i++) {
+            uint64_t face_size = cube[0].level_sizes[i];
+            uint8_t *level = ARENA_PUSH_ARRAY(scratch, uint8_t, face_size * 6);
+            if (!level) {
+                printf("Out of scratch memory baking %s\n", baked_path);
+                ok = false;
+                break;
+            }
+            for (int f = 0; f < 6; f++) {
+                memcpy(level + face_size * f, cube[f].levels[i], (size_t)face_size);
+            }
+            cube_levels[i] = level;
+            cube_sizes[i] = face_size * 6;
+        }
+    }
+    if (ok) {
+        header.face_count = 6;
+        platform_make_directory(BAKED_TEXTURE_DIRECTORY);
+        ok = baked_texture_write(baked_path, &header, cube_levels, cube_sizes);
+    }
+
+    for (int f = 0; f < 6; f++) {
+        // levels only exist once every face decoded, level 0 may be the pixels
+        if (cube[f].levels[0]) free_levels(&cube[f].header, cube[f].levels);
+        free(cube[f].pixels);
+    }
+    arena_temp_end(temp);
+    if (ok) {
+        printf("Baked cube map %s.. -> %s\n", faces[0], baked_path);
+    }
+    return ok;
+}
+
+bool texture_bake_cube_ensure(const char **faces, uint32_t flags, char *out_path, int out_size) {
+    texture_bake_cube_path(faces, flags, out_path, out_size);
+    int64_t source_time = 0;
+    for (int f = 0; f < 6; f++) {
+        int64_t face_time = asset_mtime(faces[f]);
+        if (face_time < 0) {
+            printf("Failed to load texture: %s\n", faces[f]);
+            return false;
+        }
+        if (face_time > source_time) source_time = face_time;
+    }
+    int64_t baked_time = platform_file_mtime(out_path);
+    if (baked_time >= 0 && baked_time >= source_time && baked_texture_is_current(out_path, flags)) {
+        return true;
+    }
+    return texture_bake_cube(faces, out_path, flags);
+}
@@ -0,0 +1,102 @@
+#ifndef TEXTURE_BAKE_H
+#define TEXTURE_BAKE_H
+
+#include <stdint.h>
+
+#include "bc_encoder.h"
+#include "mip_gen.h"
+
+// Baked textures are stored with every mip level ready for upload, in a
+// KTX2-like container: identifier, header, level index, then level data.
+// Each level holds all faces back to back. Level data is 16 byte aligned.
+
+#define BAKED_TEXTURE_VERSION 1
+#define BAKED_TEXTURE_DIRECTORY "baked"
+#define BAKED_TEXTURE_ALIGNMENT 16
+
+// bake flags, recorded in the header so a change forces a rebake
+#define BAKE_FLIP_VERTICALLY (1 << 0)
+// block compress every level, at most one of these
+#define BAKE_COMPRESS_BC1 (1 << 1)
+#define BAKE_COMPRESS_BC4 (1 << 2)
+#define BAKE_COMPRESS_BC5 (1 << 3)
+#define BAKE_COMPRESS_BC7 (1 << 4)
+#define BAKE_COMPRESS_MASK (BAKE_COMPRESS_BC1 | BAKE_COMPRESS_BC4 | BAKE_COMPRESS_BC5 | BAKE_COMPRESS_BC7)
+// source rgb is sRGB encoded, mips are filtered in linear space
+#define BAKE_SRGB (1 << 5)
+// mips keep the alpha test coverage of level 0 at TEXTURE_BAKE_ALPHA_CUTOFF
+#define BAKE_ALPHA_COVERAGE (1 << 6)
+// keep only red (masks) or red and green (normal maps). Otherwise the
+// source channel count picks RGB or RGBA.
+#define BAKE_CHANNELS_R (1 << 7)
+#define BAKE_CHANNELS_RG (1 << 8)
+// resample to the next power of two in each dimension, so textures of
+// nearly the same size can share a texture array
+#define BAKE_RESIZE_POW2 (1 << 9)
+
+#define TEXTURE_BAKE_ALPHA_CUTOFF 0.5f
+
+extern Bc_Quality texture_bake_quality;
+extern Mip_Filter texture_bake_filter;
+
+struct Baked_Texture_Header {
+    uint8_t identifier[12];
+    uint32_t version;
+    uint32_t gl_internal_format;
+    uint32_t gl_format; // 0 for compressed formats
+    uint32_t gl_type;   // 0 for compressed formats
+    uint32_t width;
+    uint32_t height;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct Baked_Level {
+    uint64_t offset; // from the start of the file
+    uint64_t size;   // all faces
+};
+
+// Parsed view into a baked file, usually a memory mapping
+struct Baked_Texture {
+    const Baked_Texture_Header *header;
+    const Baked_Level *levels;
+    const uint8_t *file;
+};
+
+bool baked_texture_parse(const void *data, int64_t size, Baked_Texture *out_baked);
+const uint8_t *baked_texture_face(Baked_Texture *baked, int level, int face, int64_t *out_size);
+int baked_texture_level_width(const Baked_Texture_Header *header, int level);
+int baked_texture_level_height(const Baked_Texture_Header *header, int level);
+// A level is uploaded in rows: pixel rows, or rows of 4x4 blocks when compressed
+void baked_texture_rows(const Baked_Texture_Header *header, int level, int *out_row_size, int *out_row_count, int *out_row_height);
+int gl_format_bytes_per_pixel(uint32_t format, uint32_t type);
+
+// Colour maps are baked sRGB, but until the lighting is retuned for linear
+// values they are stored in the UNORM format with the same bytes, so shaders
+// sample the encoded values as before. 1 decodes them on sampling, which
+// wants GL_FRAMEBUFFER_SRGB and linear light constants along with it.
+#define TEXTURE_SAMPLE_LINEAR 0
+// The internal format textures of a baked format are created with
+uint32_t gl_storage_format(uint32_t internal_format);
+
+// levels[i] points to level i with all faces back to back
+bool baked_texture_write(const char *path, Baked_Texture_Header *header, const void **levels, const uint64_t *level_sizes);
+
+// alpha_source, when not NULL, is a single channel map (specular, roughness,
+// AO) whose red channel replaces the alpha of source, resampled to its size.
+void texture_bake_path(const char *source, const char *alpha_source, uint32_t flags, char *out_path, int out_size);
+// Bakes source when the baked file is missing, older than the sources or was
+// baked with other flags. Returns false if there is nothing usable to load.
+bool texture_bake_ensure(const char *source, const char *alpha_source, uint32_t flags, char *out_path, int out_size);
+bool texture_bake(const char *source, const char *alpha_source, const char *baked_path, uint32_t flags);
+
+// The six faces of a cube map in one file, +X, -X, +Y, -Y, +Z, -Z, every
+// level holding all faces back to back, so the sky loads with one mapping.
+// Faces must be square and the same size.
+void texture_bake_cube_path(const char **faces, uint32_t flags, char *out_path, int out_size);
+bool texture_bake_cube_ensure(const char **faces, uint32_t flags, char *out_path, int out_size);
+bool texture_bake_cube(const char **faces, const char *baked_path, uint32_t flags);
+
+#endif // TEXTURE_BAKE_H
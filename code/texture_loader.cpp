@@ -0,0 +1,781 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <atomic>
+
+#include "texture_loader.h"
+#include "texture_bake.h"
+#include "platform.h"
+#include "job_system.h"
+#include "resource_registry.h"
+#include "alloc_tracker.h"
+#include "asset_pack.h"
+
+#define UPLOAD_RING_SIZE (16 * 1024 * 1024)
+// updates whose uploads may still be read by the GPU, one fence each
+#define UPLOAD_RING_FRAMES 8
+#define UPLOAD_RING_ALIGNMENT 16
+#define TEXTURE_MAX_FACES TEXTURE_ARRAY_MAX_LAYERS
+// residency changes started per update, each a GPU copy and maybe a restore
+#define TEXTURE_RESIDENCY_CHANGES_PER_FRAME 2
+// updates between checks of whether the sources of a failed restore changed
+#define TEXTURE_RESTORE_RETRY_FRAMES 60
+
+enum Face_State {
+    FACE_PENDING,
+    FACE_MAPPED,
+    FACE_UPLOADED,
+    FACE_FAILED,
+};
+
+enum Texture_State {
+    TEXTURE_UNUSED,
+    TEXTURE_LOADING,
+    TEXTURE_READY,
+    TEXTURE_FAILED,
+};
+
+struct Texture_Face {
+    char path[256];
+    char alpha_path[256]; // empty unless a mask is packed into alpha
+    const char (*cube_paths)[256]; // the six faces of a cube map file, else NULL
+    uint32_t bake_flags;
+    std::atomic<int> state;
+
+    // written by the worker before state becomes FACE_MAPPED
+    Platform_Mapped_File file;
+    Baked_Texture baked;
+
+    int level; // baked level being uploaded
+    int layer; // of the file, cube map files hold six
+    int rows_uploaded;
+};
+
+// Faces are the files of a texture: the one image of a 2D texture or a cube
+// map, or the layers of an array
+struct Texture_Slot {
+    Texture_Handle handle;
+    bool free_pending; // last reference dropped, freed once no worker uses it
+    Texture_State state;
+    GLenum target;
+    GLuint texture;  // drawn, level 0 is baked level base_level
+    int base_level;
+    Baked_Texture_Header storage; // of the first face mapped, the rest must match
+    uint64_t level_bytes[TEXTURE_MAX_LEVELS]; // all faces
+    int face_count;
+    Texture_Face faces[TEXTURE_MAX_FACES];
+    char cube_paths[6][256];
+
+    // storage being filled by the first load or a restore, replaces texture
+    // once baked levels upload_base up to upload_end are uploaded
+    GLuint upload_texture;
+    int upload_base;
+    int upload_end;
+    bool restore_failed;   // held at base_level until a source changes
+    int64_t restore_mtime; // newest source mtime when the last restore started
+
+    float screen_size;      // largest reported this frame
+    float last_screen_size; // of the last frame it was reported, 0 if never
+    uint64_t last_used;
+};
+
+struct Upload_Frame {
+    GLsync fence;
+    uint64_t end; // head when the update finished
+};
+
+// Uploads are bump allocated, so the small levels and faces of an update
+// share the space and the one fence of that update. head and tail only
+// grow, the offset into the buffer is taken modulo its size.
+struct Upload_Ring {
+    GLuint buffer;
+    unsigned char *mapped;
+    uint64_t head;       // next byte to hand out
+    uint64_t tail;       // oldest byte the GPU may still read
+    uint64_t frame_head; // head when this update started
+    Upload_Frame frames[UPLOAD_RING_FRAMES];
+    int first_frame;
+    int frame_count;
+};
+
+static Texture_Slot texture_slots[TEXTURE_LOADER_MAX_TEXTURES];
+static int texture_slot_count; // high water mark of used slot indices
+static Resource_Registry texture_registry;
+static Upload_Ring upload_ring;
+static GLuint placeholder_2d;
+static GLuint placeholder_cube;
+static GLuint placeholder_array; // one layer, the layer index clamps to it
+static bool compress_textures;
+static bool progressive_textures;
+static int64_t texture_budget;
+static uint64_t residency_frame = 1;
+
+// Rebakes the source if needed and maps the baked file
+static void load_face(void *data) {
+    ALLOC_ZONE("texture_load");
+    Texture_Face *face = (Texture_Face *)data;
+    char baked_path[512];
+    const char *alpha_path = face->alpha_path[0] ? face->alpha_path : NULL;
+    bool ok;
+    if (face->cube_paths) {
+        const char *paths[6];
+        for (int f = 0; f < 6; f++) paths[f] = face->cube_paths[f];
+        ok = texture_bake_cube_ensure(paths, face->bake_flags, baked_path, sizeof(baked_path));
+    } else {
+        ok = texture_bake_ensure(face->path, alpha_path, face->bake_flags, baked_path, sizeof(baked_path));
+    }
+    ok = ok && platform_map_file(baked_path, &face->file);
+    // levels are read front to back, from the preview or restore level on
+    if (ok) platform_advise(&face->file, 0, 0, PLATFORM_ACCESS_SEQUENTIAL);
+    ok = ok && baked_texture_parse(face->file.data, face->file.size, &face->baked);
+    if (!ok && face->file.data) {
+        platform_unmap_file(&face->file);
+    }
+    face->state.store(ok ? FACE_MAPPED : FACE_FAILED, std::memory_order_release);
+}
+
+void texture_loader_init(bool compress, bool progressive) {
+    compress_textures = compress;
+    progressive_textures = progressive;
+    resource_registry_init(&texture_registry);
+    unsigned char grey[4] = {128, 128, 128, 255};
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &placeholder_2d);
+    glTextureStorage2D(placeholder_2d, 1, GL_RGBA8, 1, 1);
+    glTextureSubImage2D(placeholder_2d, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+    glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &placeholder_cube);
+    glTextureStorage2D(placeholder_cube, 1, GL_RGBA8, 1, 1);
+    for (int face = 0; face < 6; face++) {
+        glTextureSubImage3D(placeholder_cube, 0, 0, 0, face, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    }
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &placeholder_array);
+    glTextureStorage3D(placeholder_array, 1, GL_RGBA8, 1, 1, 1);
+    glTextureSubImage3D(placeholder_array, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &upload_ring.buffer);
+    glNamedBufferStorage(upload_ring.buffer, UPLOAD_RING_SIZE, NULL, flags);
+    upload_ring.mapped = (unsigned char *)glMapNamedBufferRange(upload_ring.buffer, 0, UPLOAD_RING_SIZE, flags);
+    assert(upload_ring.mapped);
+}
+
+// No worker may still be loading a face of the slot
+static void texture_slot_free(Texture_Slot *slot) {
+    for (int f = 0; f < slot->face_count; f++) {
+        Texture_Face *face = &slot->faces[f];
+        if (face->file.data) platform_unmap_file(&face->file);
+        face->baked = {};
+        face->cube_paths = NULL;
+        face->level = 0;
+        face->layer = 0;
+        face->rows_uploaded = 0;
+    }
+    glDeleteTextures(1, &slot->texture);
+    glDeleteTextures(1, &slot->upload_texture);
+    slot->texture = 0;
+    slot->upload_texture = 0;
+    slot->base_level = 0;
+    slot->restore_failed = false;
+    slot->restore_mtime = 0;
+    slot->screen_size = 0.0f;
+    slot->last_screen_size = 0.0f;
+    slot->face_count = 0;
+    slot->storage = {};
+    slot->free_pending = false;
+    slot->handle = {};
+    slot->state = TEXTURE_UNUSED;
+}
+
+void texture_loader_shutdown() {
+    // the job system must be shut down first so no worker still writes into a slot
+    for (int i = 0; i < texture_slot_count; i++) {
+        texture_slot_free(&texture_slots[i]);
+    }
+    texture_slot_count = 0;
+    resource_registry_free(&texture_registry);
+
+    for (int i = 0; i < upload_ring.frame_count; i++) {
+        glDeleteSync(upload_ring.frames[(upload_ring.first_frame + i) % UPLOAD_RING_FRAMES].fence);
+    }
+    glUnmapNamedBuffer(upload_ring.buffer);
+    glDeleteBuffers(1, &upload_ring.buffer);
+    upload_ring = {};
+
+    glDeleteTextures(1, &placeholder_2d);
+    glDeleteTextures(1, &placeholder_cube);
+    glDeleteTextures(1, &placeholder_array);
+}
+
+static int append_key_path(char *out_key, int n, int out_size, char separator, const char *path) {
+    if (n >= out_size - 1) return n;
+    out_key[n++] = separator;
+    resource_normalize_path(path, out_key + n, out_size - n);
+    return n + (int)strlen(out_key + n);
+}
+
+// Target, bake flags and normalized paths, so equal requests share a texture
+static void texture_key(GLenum target, const char **paths, const char **alpha_paths, int count, uint32_t bake_flags, char *out_key, int out_size) {
+    int n = snprintf(out_key, out_size, "%x:%x", target, bake_flags);
+    for (int i = 0; i < count; i++) {
+        n = append_key_path(out_key, n, out_size, ':', paths[i]);
+        if (alpha_paths && alpha_paths[i]) {
+            n = append_key_path(out_key, n, out_size, '+', alpha_paths[i]);
+        }
+    }
+}
+
+// alpha_paths may be NULL, or hold a mask to pack into the alpha of each face
+static Texture_Handle texture_request(GLenum target, const char **paths, const char **alpha_paths, int count, uint32_t bake_flags) {
+    assert(count <= TEXTURE_MAX_FACES);
+    char key[RESOURCE_KEY_SIZE];
+    texture_key(target, paths, alpha_paths, count, bake_flags, key, sizeof(key));
+
+    Texture_Handle handle;
+    if (!resource_acquire(&texture_registry, key, &handle)) {
+        // already loaded or loading, maybe released this frame and not freed yet
+        texture_slots[handle.index].free_pending = false;
+        return handle;
+    }
+    if (handle.index >= TEXTURE_LOADER_MAX_TEXTURES) {
+        printf("Texture loader is full, dropping %s\n", paths[0]);
+        resource_release(&texture_registry, handle);
+        resource_remove(&texture_registry, handle);
+        return {};
+    }
+    if ((int)handle.index >= texture_slot_count) texture_slot_count = handle.index + 1;
+
+    Texture_Slot *slot = &texture_slots[handle.index];
+    slot->handle = handle;
+    slot->free_pending = false;
+    slot->state = TEXTURE_LOADING;
+    slot->target = target;
+    // a cube map is baked to one file of six faces
+    bool cube = target == GL_TEXTURE_CUBE_MAP;
+    if (cube) {
+        for (int i = 0; i < 6; i++) {
+            snprintf(slot->cube_paths[i], sizeof(slot->cube_paths[i]), "%s", paths[i]);
+        }
+        count = 1;
+    }
+    slot->face_count = count;
+    for (int i = 0; i < count; i++) {
+        Texture_Face *face = &slot->faces[i];
+        snprintf(face->path, sizeof(face->path), "%s", paths[i]);
+        face->cube_paths = cube ? slot->cube_paths : NULL;
+        const char *alpha_path = alpha_paths ? alpha_paths[i] : NULL;
+        snprintf(face->alpha_path, sizeof(face->alpha_path), "%s", alpha_path ? alpha_path : "");
+        face->bake_flags = bake_flags;
+        face->state.store(FACE_PENDING);
+        job_run(load_face, face, NULL);
+    }
+    return handle;
+}
+
+static uint32_t usage_bake_flags(Texture_Usage usage) {
+    switch (usage) {
+    case TEXTURE_USAGE_MASK: return compress_textures ? BAKE_COMPRESS_BC4 : BAKE_CHANNELS_R;
+    case TEXTURE_USAGE_NORMAL: return compress_textures ? BAKE_COMPRESS_BC5 : BAKE_CHANNELS_RG;
+    default: return BAKE_SRGB | (compress_textures ? BAKE_COMPRESS_BC7 : 0);
+    }
+}
+
+Texture_Handle texture_load(const char *path, Texture_Usage usage) {
+    return texture_request(GL_TEXTURE_2D, &path, NULL, 1, BAKE_FLIP_VERTICALLY | usage_bake_flags(usage));
+}
+
+Texture_Handle texture_load_packed(const char *color_path, const char *mask_path) {
+    return texture_request(GL_TEXTURE_2D, &color_path, &mask_path, 1, BAKE_FLIP_VERTICALLY | usage_bake_flags(TEXTURE_USAGE_COLOR));
+}
+
+Texture_Handle texture_load_cube(const char **face_paths) {
+    return texture_request(GL_TEXTURE_CUBE_MAP, face_paths, NULL, 6, usage_bake_flags(TEXTURE_USAGE_COLOR));
+}
+
+Texture_Handle texture_load_array(const char **paths, const char **mask_paths, int count, Texture_Usage usage) {
+    if (count > TEXTURE_ARRAY_MAX_LAYERS) {
+        printf("Texture array of %d layers is over the limit of %d\n", count, TEXTURE_ARRAY_MAX_LAYERS);
+        return {};
+    }
+    if (mask_paths) usage = TEXTURE_USAGE_COLOR;
+    uint32_t flags = BAKE_FLIP_VERTICALLY | BAKE_RESIZE_POW2 | usage_bake_flags(usage);
+    return texture_request(GL_TEXTURE_2D_ARRAY, paths, mask_paths, count, flags);
+}
+
+void texture_retain(Texture_Handle texture) {
+    resource_retain(&texture_registry, texture);
+}
+
+void texture_release(Texture_Handle texture) {
+    if (resource_release(&texture_registry, texture)) {
+        texture_slots[texture.index].free_pending = true;
+    }
+}
+
+static Texture_Slot *texture_slot(Texture_Handle texture) {
+    if (!resource_valid(&texture_registry, texture)) return NULL;
+    return &texture_slots[texture.index];
+}
+
+GLuint texture_get(Texture_Handle texture) {
+    Texture_Slot *slot = texture_slot(texture);
+    if (slot && slot->state == TEXTURE_READY) {
+        return slot->texture;
+    }
+    GLenum target = slot ? slot->target : GL_TEXTURE_2D;
+    if (target == GL_TEXTURE_CUBE_MAP) return placeholder_cube;
+    if (target == GL_TEXTURE_2D_ARRAY) return placeholder_array;
+    return placeholder_2d;
+}
+
+bool texture_ready(Texture_Handle texture) {
+    Texture_Slot *slot = texture_slot(texture);
+    return slot && slot->state == TEXTURE_READY;
+}
+
+int texture_loader_pending() {
+    int pending = 0;
+    for (int i = 0; i < texture_slot_count; i++) {
+        Texture_Slot *slot = &texture_slots[i];
+        bool streaming = slot->state == TEXTURE_LOADING || (slot->state == TEXTURE_READY && slot->upload_texture);
+        if (streaming && !slot->free_pending) pending++;
+    }
+    return pending;
+}
+
+static bool baked_texture_same_storage(const Baked_Texture_Header *a, const Baked_Texture_Header *b) {
+    return a->width == b->width && a->height == b->height && a->level_count == b->level_count && a->face_count == b->face_count &&
+           a->gl_internal_format == b->gl_internal_format && a->gl_format == b->gl_format && a->gl_type == b->gl_type;
+}
+
+// Array layers or cube faces, over all files
+static int texture_layer_count(Texture_Slot *slot) {
+    return (int)slot->storage.face_count * slot->face_count;
+}
+
+// Storage for baked levels base_level and down of slot->storage
+static GLuint texture_create_storage(Texture_Slot *slot, int base_level) {
+    const Baked_Texture_Header *header = &slot->storage;
+    int levels = (int)header->level_count - base_level;
+    int width = baked_texture_level_width(header, base_level);
+    int height = baked_texture_level_height(header, base_level);
+    GLuint texture;
+    glCreateTextures(slot->target, 1, &texture);
+    if (slot->target == GL_TEXTURE_2D_ARRAY) {
+        glTextureStorage3D(texture, levels, gl_storage_format(header->gl_internal_format), width, height, texture_layer_count(slot));
+    } else {
+        glTextureStorage2D(texture, levels, gl_storage_format(header->gl_internal_format), width, height);
+    }
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void texture_storage_init(Texture_Slot *slot, Baked_Texture *baked) {
+    slot->storage = *baked->header;
+    assert(slot->storage.level_count <= TEXTURE_MAX_LEVELS);
+    for (uint32_t level = 0; level < slot->storage.level_count; level++) {
+        slot->level_bytes[level] = baked->levels[level].size * slot->face_count;
+    }
+}
+
+// First level no larger than TEXTURE_PREVIEW_SIZE
+static int texture_preview_level(const Baked_Texture_Header *header) {
+    int level = 0;
+    while (level + 1 < (int)header->level_count &&
+           (baked_texture_level_width(header, level) > TEXTURE_PREVIEW_SIZE || baked_texture_level_height(header, level) > TEXTURE_PREVIEW_SIZE)) {
+        level++;
+    }
+    return level;
+}
+
+static int64_t texture_bytes(Texture_Slot *slot, int base_level) {
+    int64_t bytes = 0;
+    for (int level = base_level; level < (int)slot->storage.level_count; level++) {
+        bytes += slot->level_bytes[level];
+    }
+    return bytes;
+}
+
+// Frees the space of updates the GPU is done with
+static void upload_ring_retire() {
+    while (upload_ring.frame_count > 0) {
+        Upload_Frame *frame = &upload_ring.frames[upload_ring.first_frame];
+        GLenum status = glClientWaitSync(frame->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) break;
+        glDeleteSync(frame->fence);
+        upload_ring.tail = frame->end;
+        upload_ring.first_frame = (upload_ring.first_frame + 1) % UPLOAD_RING_FRAMES;
+        upload_ring.frame_count--;
+    }
+}
+
+// Hands out as many of rows as fit before the end of the buffer or the
+// space still being read, at least one. Returns the offset, or -1 when not
+// even one row fits.
+static int64_t upload_ring_alloc(int row_size, int rows, int *out_rows) {
+    // the fence of this update needs a free frame
+    if (upload_ring.frame_count == UPLOAD_RING_FRAMES) return -1;
+    uint64_t head = (upload_ring.head + UPLOAD_RING_ALIGNMENT - 1) & ~(uint64_t)(UPLOAD_RING_ALIGNMENT - 1);
+    uint64_t offset = head % UPLOAD_RING_SIZE;
+    if (UPLOAD_RING_SIZE - offset < (uint64_t)row_size) {
+        // a row does not fit before the end, wrap to the start
+        head += UPLOAD_RING_SIZE - offset;
+        offset = 0;
+    }
+    if (head - upload_ring.tail >= UPLOAD_RING_SIZE) return -1;
+    uint64_t space = UPLOAD_RING_SIZE - (head - upload_ring.tail);
+    if (space > UPLOAD_RING_SIZE - offset) space = UPLOAD_RING_SIZE - offset;
+    uint64_t fit = space / (uint64_t)row_size;
+    if (fit == 0) return -1;
+    if ((uint64_t)rows > fit) rows = (int)fit;
+    upload_ring.head = head + (uint64_t)rows * row_size;
+    *out_rows = rows;
+    return (int64_t)offset;
+}
+
+// One fence covers everything this update uploaded
+static void upload_ring_end_frame() {
+    if (upload_ring.head == upload_ring.frame_head) return;
+    int index = (upload_ring.first_frame + upload_ring.frame_count) % UPLOAD_RING_FRAMES;
+    upload_ring.frames[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    upload_ring.frames[index].end = upload_ring.head;
+    upload_ring.frame_count++;
+    upload_ring.frame_head = upload_ring.head;
+}
+
+// Copies rows of every level and layer of one face from the mapping through
+// the ring, until the face is done or the ring is full. Compressed levels go
+// up in rows of 4x4 blocks.
+static bool upload_face(Texture_Slot *slot, int face_index) {
+    Texture_Face *face = &slot->faces[face_index];
+    const Baked_Texture_Header *header = face->baked.header;
+    bool compressed = bc_block_bytes_for_gl_format(header->gl_internal_format) != 0;
+
+    while (face->level < slot->upload_end) {
+        int width = baked_texture_level_width(header, face->level);
+        int height = baked_texture_level_height(header, face->level);
+        int row_size, row_count, row_height;
+        baked_texture_rows(header, face->level, &row_size, &row_count, &row_height);
+        assert(row_size <= UPLOAD_RING_SIZE / UPLOAD_RING_FRAMES);
+        const uint8_t *pixels = baked_texture_face(&face->baked, face->level, face->layer, NULL);
+        // cube faces and array layers are both addressed by z
+        int z = face_index * (int)header->face_count + face->layer;
+
+        while (face->rows_uploaded < row_count) {
+            int rows;
+            int64_t ring_offset = upload_ring_alloc(row_size, row_count - face->rows_uploaded, &rows);
+            if (ring_offset < 0) return false;
+
+            size_t offset = (size_t)ring_offset;
+            int bytes = rows * row_size;
+            memcpy(upload_ring.mapped + offset, pixels + (size_t)face->rows_uploaded * row_size, bytes);
+
+            int y = face->rows_uploaded * row_height;
+            int h = rows * row_height;
+            if (y + h > height) h = height - y;
+            GLenum format = gl_storage_format(header->gl_internal_format);
+            GLuint texture = slot->upload_texture;
+            int level = face->level - slot->upload_base;
+            bool layered = slot->target != GL_TEXTURE_2D;
+            if (layered && compressed) {
+                glCompressedTextureSubImage3D(texture, level, 0, y, z, width, h, 1, format, bytes, (void *)offset);
+            } else if (layered) {
+                glTextureSubImage3D(texture, level, 0, y, z, width, h, 1, header->gl_format, header->gl_type, (void *)offset);
+            } else if (compressed) {
+                glCompressedTextureSubImage2D(texture, level, 0, y, width, h, format, bytes, (void *)offset);
+            } else {
+                glTextureSubImage2D(texture, level, 0, y, width, h, header->gl_format, header->gl_type, (void *)offset);
+            }
+            face->rows_uploaded += rows;
+        }
+        face->rows_uploaded = 0;
+        face->layer++;
+        if (face->layer == (int)header->face_count) {
+            face->layer = 0;
+            face->level++;
+        }
+    }
+
+    platform_unmap_file(&face->file);
+    face->baked = {};
+    face->state.store(FACE_UPLOADED, std::memory_order_relaxed);
+    return true;
+}
+
+// Copies baked levels first_level and down from the drawn texture into
+// texture, whose level 0 is baked level texture_base
+static void texture_copy_levels(Texture_Slot *slot, GLuint texture, int texture_base, int first_level) {
+    int depth = texture_layer_count(slot);
+    for (int level = first_level; level < (int)slot->storage.level_count; level++) {
+        int width = baked_texture_level_width(&slot->storage, level);
+        int height = baked_texture_level_height(&slot->storage, level);
+        glCopyImageSubData(slot->texture, slot->target, level - slot->base_level, 0, 0, 0,
+                           texture, slot->target, level - texture_base, 0, 0, 0, width, height, depth);
+    }
+}
+
+static void texture_drop_levels(Texture_Slot *slot, int base_level) {
+    GLuint texture = texture_create_storage(slot, base_level);
+    texture_copy_levels(slot, texture, base_level, base_level);
+    glDeleteTextures(1, &slot->texture);
+    slot->texture = texture;
+    slot->base_level = base_level;
+}
+
+static int64_t texture_source_mtime(Texture_Slot *slot) {
+    int64_t newest = -1;
+    for (int f = 0; f < slot->face_count; f++) {
+        Texture_Face *face = &slot->faces[f];
+        const char *paths[6];
+        int count = 0;
+        if (face->cube_paths) {
+            for (int i = 0; i < 6; i++) paths[count++] = face->cube_paths[i];
+        } else {
+            paths[count++] = face->path;
+            if (face->alpha_path[0]) paths[count++] = face->alpha_path;
+        }
+        for (int i = 0; i < count; i++) {
+            int64_t mtime = asset_mtime(paths[i]);
+            if (mtime > newest) newest = mtime;
+        }
+    }
+    return newest;
+}
+
+// The resident levels are copied now, the missing ones load like a new texture
+static void texture_restore_levels(Texture_Slot *slot, int base_level) {
+    slot->restore_mtime = texture_source_mtime(slot);
+    slot->upload_texture = texture_create_storage(slot, base_level);
+    slot->upload_base = base_level;
+    slot->upload_end = slot->base_level;
+    texture_copy_levels(slot, slot->upload_texture, base_level, slot->base_level);
+    for (int f = 0; f < slot->face_count; f++) {
+        Texture_Face *face = &slot->faces[f];
+        face->level = base_level;
+        face->layer = 0;
+        face->rows_uploaded = 0;
+        face->state.store(FACE_PENDING);
+        job_run(load_face, face, NULL);
+    }
+}
+
+static bool texture_faces_loading(Texture_Slot *slot) {
+    for (int f = 0; f < slot->face_count; f++) {
+        if (slot->faces[f].state.load(std::memory_order_acquire) == FACE_PENDING) return true;
+    }
+    return false;
+}
+
+// Unmaps faces that are mapped but will not be uploaded. Faces still loading
+// when an upload fails are caught by a later call.
+static void texture_release_faces(Texture_Slot *slot) {
+    for (int f = 0; f < slot->face_count; f++) {
+        Texture_Face *face = &slot->faces[f];
+        if (face->state.load(std::memory_order_acquire) == FACE_MAPPED) {
+            platform_unmap_file(&face->file);
+            face->baked = {};
+            face->state.store(FACE_FAILED, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void texture_upload_failed(Texture_Slot *slot) {
+    texture_release_faces(slot);
+    glDeleteTextures(1, &slot->upload_texture);
+    slot->upload_texture = 0;
+    if (slot->state == TEXTURE_LOADING) {
+        slot->state = TEXTURE_FAILED;
+    } else {
+        // a restore, keep drawing the levels that are resident
+        slot->restore_failed = true;
+    }
+}
+
+// Coarsest level that is still at least the reported size on screen
+static int texture_needed_level(Texture_Slot *slot) {
+    if (slot->last_screen_size <= 0.0f) return 0;
+    const Baked_Texture_Header *header = &slot->storage;
+    float size = (float)(header->width > header->height ? header->width : header->height);
+    int level = 0;
+    while (level + 1 < (int)header->level_count && size * 0.5f >= slot->last_screen_size) {
+        size *= 0.5f;
+        level++;
+    }
+    return level;
+}
+
+// Picks the levels each texture keeps this frame, then shrinks the least
+// recently used ones a level at a time until they fit the budget
+static void texture_residency_update() {
+    int wanted[TEXTURE_LOADER_MAX_TEXTURES];
+    int64_t total = 0;
+    for (int i = 0; i < texture_slot_count; i++) {
+        Texture_Slot *slot = &texture_slots[i];
+        wanted[i] = -1;
+        if (slot->screen_size > 0.0f) {
+            slot->last_screen_size = slot->screen_size;
+            slot->screen_size = 0.0f;
+        }
+        if (slot->free_pending || slot->state == TEXTURE_FAILED) continue;
+        if (slot->upload_texture) {
+            // loading or restoring, counted at the size it will have
+            total += texture_bytes(slot, slot->upload_base);
+            continue;
+        }
+        if (slot->state != TEXTURE_READY) continue;
+
+        // never reported, always in use
+        if (slot->last_screen_size <= 0.0f) slot->last_used = residency_frame;
+        int need = texture_needed_level(slot);
+        // one level finer than needed is kept, so sizes near a level boundary do not thrash
+        wanted[i] = need == slot->base_level + 1 ? slot->base_level : need;
+        if (slot->restore_failed) {
+            // retrying would fail the same way until a source is edited, so
+            // that is checked now and then, once the failed loads are done
+            if (wanted[i] < slot->base_level) wanted[i] = slot->base_level;
+            if ((residency_frame + i) % TEXTURE_RESTORE_RETRY_FRAMES == 0 && !texture_faces_loading(slot)) {
+                slot->restore_failed = texture_source_mtime(slot) == slot->restore_mtime;
+            }
+        }
+        total += texture_bytes(slot, wanted[i]);
+    }
+
+    while (texture_budget > 0 && total > texture_budget) {
+        int victim = -1;
+        for (int i = 0; i < texture_slot_count; i++) {
+            if (wanted[i] < 0 || wanted[i] + 1 >= (int)texture_slots[i].storage.level_count) continue;
+            if (victim < 0) {
+                victim = i;
+                continue;
+            }
+            Texture_Slot *slot = &texture_slots[i];
+            Texture_Slot *best = &texture_slots[victim];
+            // least recently used first, then whichever frees the most
+            if (slot->last_used < best->last_used ||
+                (slot->last_used == best->last_used && slot->level_bytes[wanted[i]] > best->level_bytes[wanted[victim]])) {
+                victim = i;
+            }
+        }
+        if (victim < 0) break; // everything is down to its last level
+        total -= texture_slots[victim].level_bytes[wanted[victim]];
+        wanted[victim]++;
+    }
+
+    // drops first, they make the room restores need
+    int changes = 0;
+    for (int i = 0; i < texture_slot_count && changes < TEXTURE_RESIDENCY_CHANGES_PER_FRAME; i++) {
+        if (wanted[i] > texture_slots[i].base_level) {
+            texture_drop_levels(&texture_slots[i], wanted[i]);
+            changes++;
+        }
+    }
+    for (int i = 0; i < texture_slot_count && changes < TEXTURE_RESIDENCY_CHANGES_PER_FRAME; i++) {
+        if (wanted[i] >= 0 && wanted[i] < texture_slots[i].base_level) {
+            texture_restore_levels(&texture_slots[i], wanted[i]);
+            changes++;
+        }
+    }
+    residency_frame++;
+}
+
+void texture_loader_update() {
+    ALLOC_ZONE("texture_loader");
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring.buffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    upload_ring_retire();
+
+    bool ring_full = false;
+    for (int i = 0; i < texture_slot_count && !ring_full; i++) {
+        Texture_Slot *slot = &texture_slots[i];
+        if (slot->free_pending) {
+            if (!texture_faces_loading(slot)) {
+                resource_remove(&texture_registry, slot->handle);
+                texture_slot_free(slot);
+            }
+            continue;
+        }
+        bool restoring = slot->state == TEXTURE_READY && slot->upload_texture;
+        if (slot->state != TEXTURE_LOADING && !restoring) {
+            texture_release_faces(slot);
+            continue;
+        }
+
+        int uploaded = 0;
+        for (int f = 0; f < slot->face_count; f++) {
+            Texture_Face *face = &slot->faces[f];
+            int state = face->state.load(std::memory_order_acquire);
+            if (state == FACE_FAILED) {
+                printf("Failed to load texture: %s\n", face->path);
+                texture_upload_failed(slot);
+                break;
+            }
+            if (state == FACE_MAPPED && !ring_full) {
+                if (!slot->upload_texture) {
+                    texture_storage_init(slot, &face->baked);
+                    // progressive loads start with the tail, residency restores the rest
+                    int base_level = progressive_textures ? texture_preview_level(&slot->storage) : 0;
+                    slot->upload_texture = texture_create_storage(slot, base_level);
+                    slot->upload_base = base_level;
+                    slot->upload_end = (int)slot->storage.level_count;
+                    for (int g = 0; g < slot->face_count; g++) {
+                        slot->faces[g].level = base_level;
+                    }
+                }
+                if (!baked_texture_same_storage(&slot->storage, face->baked.header)) {
+                    printf("Texture %s does not match the size or format of the other faces\n", face->path);
+                    texture_upload_failed(slot);
+                    break;
+                }
+                ring_full = !upload_face(slot, f);
+                state = face->state.load(std::memory_order_relaxed);
+            }
+            if (state == FACE_UPLOADED) uploaded++;
+        }
+
+        if (slot->upload_texture && uploaded == slot->face_count) {
+            // the old levels were copied out when the restore started
+            glDeleteTextures(1, &slot->texture);
+            slot->texture = slot->upload_texture;
+            slot->base_level = slot->upload_base;
+            slot->upload_texture = 0;
+            slot->state = TEXTURE_READY;
+        }
+    }
+
+    upload_ring_end_frame();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    texture_residency_update();
+}
+
+void texture_loader_set_budget(int64_t bytes) {
+    texture_budget = bytes;
+}
+
+int64_t texture_loader_resident_bytes() {
+    int64_t bytes = 0;
+    for (int i = 0; i < texture_slot_count; i++) {
+        Texture_Slot *slot = &texture_slots[i];
+        if (slot->texture) bytes += texture_bytes(slot, slot->base_level);
+        if (slot->upload_texture) bytes += texture_bytes(slot, slot->upload_base);
+    }
+    return bytes;
+}
+
+void texture_use(Texture_Handle texture, float screen_size) {
+    Texture_Slot *slot = texture_slot(texture);
+    if (!slot) return;
+    if (screen_size > slot->screen_size) slot->screen_size = screen_size;
+    slot->last_used = residency_frame;
+}
+
+float texture_screen_size(float world_size, float distance, float fov_y, float viewport_height) {
+    if (distance <= 0.0f) return viewport_height;
+    return world_size * viewport_height / (2.0f * distance * tanf(fov_y * 0.5f));
+}
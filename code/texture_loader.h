@@ -0,0 +1,81 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+
+#include "resource_registry.h"
+
+#define TEXTURE_LOADER_MAX_TEXTURES 64
+#define TEXTURE_ARRAY_MAX_LAYERS 16
+#define TEXTURE_MAX_LEVELS 16
+// progressive loads first upload the levels no larger than this
+#define TEXTURE_PREVIEW_SIZE 64
+
+// Picks the stored channels and format, uncompressed / compressed
+enum Texture_Usage {
+    TEXTURE_USAGE_COLOR,  // SRGB8 or SRGB8_ALPHA8 / BC7 sRGB
+    TEXTURE_USAGE_MASK,   // R8 / BC4, red channel only
+    TEXTURE_USAGE_NORMAL, // RG8 / BC5, red and green only
+};
+
+// Images are baked (or found already baked) on the job system, memory mapped
+// and streamed level by level into immutable textures through a persistently
+// mapped pixel unpack buffer, used as a ring with one fence per update. Until
+// a texture is complete, texture_get returns a 1x1 placeholder of the same
+// target. With compress set, textures are baked to BC4/BC5/BC7 according to
+// their usage. With progressive set, a texture is ready as soon as its small
+// tail levels from TEXTURE_PREVIEW_SIZE down are uploaded, and the larger
+// levels stream in afterwards like a restore.
+//
+// Residency: each texture keeps the mip levels that the on-screen size
+// reported with texture_use needs. While the total is over the budget the top
+// levels of the least recently used textures are dropped. Dropping copies the
+// remaining levels into smaller storage on the GPU. Restoring maps the baked
+// file again on the job system and streams the missing levels through the
+// ring, while the old texture is still drawn. Textures that are never
+// reported keep every level unless the budget needs them.
+void texture_loader_init(bool compress, bool progressive);
+void texture_loader_shutdown();
+
+typedef Resource_Handle Texture_Handle;
+
+// Loading the same paths with the same usage again returns the same texture
+// with one more reference. Returns an invalid handle if the loader is full.
+Texture_Handle texture_load(const char *path, Texture_Usage usage);
+// Colour texture with the red channel of mask_path packed into its alpha,
+// so a material reads both with one fetch
+Texture_Handle texture_load_packed(const char *color_path, const char *mask_path);
+// Faces in GL order: +X, -X, +Y, -Y, +Z, -Z. Baked together into one file
+// with every mip level, so the whole cube loads from one mapping.
+Texture_Handle texture_load_cube(const char **face_paths);
+// GL_TEXTURE_2D_ARRAY with one layer per path, for batching materials. Layers
+// are baked to power of two sizes and must end up the same size and format.
+// With mask_paths each layer is a colour map with its mask packed in alpha,
+// as texture_load_packed, and usage is ignored.
+Texture_Handle texture_load_array(const char **paths, const char **mask_paths, int count, Texture_Usage usage);
+void texture_retain(Texture_Handle texture);
+// The texture is deleted on the next update after its last release
+void texture_release(Texture_Handle texture);
+
+// Stale or invalid handles get the placeholder
+GLuint texture_get(Texture_Handle texture);
+bool texture_ready(Texture_Handle texture);
+// Textures still loading or streaming levels in
+int texture_loader_pending();
+
+// VRAM all textures together may hold, 0 for no limit
+void texture_loader_set_budget(int64_t bytes);
+int64_t texture_loader_resident_bytes();
+// Reports that texture is drawn this frame at about screen_size pixels
+// across. The largest size reported in a frame counts.
+void texture_use(Texture_Handle texture, float screen_size);
+// Pixels covered by something world_size across at distance from the eye
+float texture_screen_size(float world_size, float distance, float fov_y, float viewport_height);
+
+// Call once per frame on the GL thread. Uploads as much decoded data as the
+// ring has free space for, then moves texture levels in or out of residency.
+// Never waits on the GPU.
+void texture_loader_update();
+
+#endif // TEXTURE_LOADER_H
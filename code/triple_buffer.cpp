@@ -0,0 +1,33 @@
+#include <string.h>
+
+#include "triple_buffer.h"
+
+void triple_buffer_init(Triple_Buffer *buffer, void *slots, size_t slot_size) {
+    buffer->slots = (uint8_t *)slots;
+    buffer->slot_size = slot_size;
+    memset(slots, 0, 3 * slot_size);
+    buffer->front = 0;
+    buffer->middle.store(1, std::memory_order_relaxed);
+    buffer->back = 2;
+}
+
+void *triple_buffer_back(Triple_Buffer *buffer) {
+    return buffer->slots + buffer->back * buffer->slot_size;
+}
+
+void triple_buffer_publish(Triple_Buffer *buffer) {
+    // release so the reader sees what was written, acquire so the slot the
+    // reader gave back is done with before it is written
+    uint32_t previous = buffer->middle.exchange(buffer->back | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel);
+    buffer->back = previous & ~TRIPLE_BUFFER_FRESH;
+}
+
+const void *triple_buffer_front(Triple_Buffer *buffer, bool *out_fresh) {
+    bool fresh = (buffer->middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0;
+    if (fresh) {
+        uint32_t previous = buffer->middle.exchange(buffer->front, std::memory_order_acq_rel);
+        buffer->front = previous & ~TRIPLE_BUFFER_FRESH;
+    }
+    if (out_fresh) *out_fresh = fresh;
+    return buffer->slots + buffer->front * buffer->slot_size;
+}
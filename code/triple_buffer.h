@@ -0,0 +1,38 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Hands the newest copy of some state from one writer thread to one reader
+// thread without either waiting. There are three slots: the writer fills
+// the back one, the reader looks at the front one, and publishing or taking
+// the newest is a single exchange with the one in the middle. The writer
+// can publish as often as it likes, the reader only ever sees whole copies
+// and skips the ones it was too slow for.
+
+#define TRIPLE_BUFFER_FRESH 4u // on middle while the reader has not taken it
+
+struct Triple_Buffer {
+    uint8_t *slots;
+    size_t slot_size;
+    std::atomic<uint32_t> middle;
+    uint32_t back;  // writer only
+    uint32_t front; // reader only
+};
+
+// slots holds 3 * slot_size bytes and outlives the buffer
+void triple_buffer_init(Triple_Buffer *buffer, void *slots, size_t slot_size);
+
+// Writer: the slot to fill, then publish it. After publishing, back is a
+// different slot with stale contents, so write every field again.
+void *triple_buffer_back(Triple_Buffer *buffer);
+void triple_buffer_publish(Triple_Buffer *buffer);
+
+// Reader: the newest published slot, valid until the next call. Sets
+// out_fresh when it was published since the last call. Before anything is
+// published it is the zeroed first slot.
+const void *triple_buffer_front(Triple_Buffer *buffer, bool *out_fresh);
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,141 @@
+// Compares the vertex storage formats in vertex_format.h on a large sphere:
+// memory footprint, encode cost, streaming fetch+decode throughput and precision.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#include "mesh.h"
+#include "vertex_format.h"
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// UVs tile the texture a few times like a real mesh. Without it they are
+// i / slices, which half floats store exactly, and the uv error reads 0.
+#define SPHERE_UV_TILES 3.3f
+
+// UV sphere triangle soup with position, normal, uv
+static float *make_sphere_soup(int slices, int stacks, int *out_vertex_count) {
+    const float PI = 3.14159265358979f;
+    int vertex_count = slices * stacks * 6;
+    float *soup = (float *)malloc((size_t)vertex_count * 8 * sizeof(float));
+    float *v = soup;
+    for (int j = 0; j < stacks; j++) {
+        for (int i = 0; i < slices; i++) {
+            int quad[6][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+            for (int k = 0; k < 6; k++) {
+                float u = (float)(i + quad[k][0]) / (float)slices;
+                float t = (float)(j + quad[k][1]) / (float)stacks;
+                float phi = u * 2.0f * PI;
+                float theta = t * PI;
+                float n[3] = {sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)};
+                *v++ = n[0] * 10.0f + 3.0f;
+                *v++ = n[1] * 10.0f - 1.0f;
+                *v++ = n[2] * 10.0f;
+                *v++ = n[0];
+                *v++ = n[1];
+                *v++ = n[2];
+                *v++ = u * SPHERE_UV_TILES;
+                *v++ = t * SPHERE_UV_TILES;
+            }
+        }
+    }
+    *out_vertex_count = vertex_count;
+    return soup;
+}
+
+// Reads and decodes every attribute of every vertex the way the vertex shader
+// would. On the CPU this is compute bound for the packed formats; the bytes per
+// vertex column is what the GPU vertex fetch pays.
+static float fetch_pass(Packed_Vertices *packed) {
+    Vertex_Layout layout = vertex_format_layout(packed->format);
+    const uint8_t *data = (const uint8_t *)packed->data;
+    float sum = 0.0f;
+    for (int i = 0; i < packed->vertex_count; i++) {
+        const uint8_t *v = data + i * layout.stride;
+        if (packed->format == VERTEX_FORMAT_FLOAT) {
+            const float *f = (const float *)v;
+            sum += f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7];
+        } else {
+            const uint16_t *p = (const uint16_t *)v;
+            sum += packed->pos_offset[0] + p[0] * packed->pos_scale[0] * (1.0f / 65535.0f);
+            sum += packed->pos_offset[1] + p[1] * packed->pos_scale[1] * (1.0f / 65535.0f);
+            sum += packed->pos_offset[2] + p[2] * packed->pos_scale[2] * (1.0f / 65535.0f);
+            if (packed->format == VERTEX_FORMAT_PACKED) {
+                uint32_t n = *(const uint32_t *)(v + 8);
+                int32_t x = (int32_t)(n << 22) >> 22;
+                int32_t y = (int32_t)(n << 12) >> 22;
+                int32_t z = (int32_t)(n << 2) >> 22;
+                sum += (float)(x + y + z) * (1.0f / 511.0f);
+            } else {
+                const int16_t *n = (const int16_t *)(v + 8);
+                sum += (float)(n[0] + n[1]) * (1.0f / 32767.0f);
+            }
+            sum += half_to_float(p[6]) + half_to_float(p[7]);
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    int slices = 1024;
+    int stacks = 512;
+    if (argc > 2) {
+        slices = atoi(argv[1]);
+        stacks = atoi(argv[2]);
+    }
+
+    int soup_count;
+    float *soup = make_sphere_soup(slices, stacks, &soup_count);
+    Mesh_Data mesh = mesh_build(soup, soup_count, 8, "sphere");
+    free(soup);
+
+    float *decoded = (float *)malloc((size_t)mesh.vertex_count * 8 * sizeof(float));
+    const int FETCH_RUNS = 20;
+
+    printf("\n%-11s %8s %10s %11s %12s %12s %12s %10s\n",
+           "format", "B/vertex", "MB", "encode ms", "decode GB/s", "pos err", "normal deg", "uv err");
+    for (int f = 0; f < VERTEX_FORMAT_COUNT; f++) {
+        Vertex_Format format = (Vertex_Format)f;
+        Vertex_Layout layout = vertex_format_layout(format);
+
+        double start = now_seconds();
+        Packed_Vertices packed = vertex_format_encode(mesh.vertices, mesh.vertex_count, format);
+        double encode_ms = (now_seconds() - start) * 1000.0;
+
+        volatile float sink = 0.0f;
+        start = now_seconds();
+        for (int run = 0; run < FETCH_RUNS; run++) {
+            sink = sink + fetch_pass(&packed);
+        }
+        double fetch_seconds = (now_seconds() - start) / FETCH_RUNS;
+        double bytes = (double)mesh.vertex_count * layout.stride;
+
+        vertex_format_decode(&packed, decoded);
+        double pos_error = 0.0, normal_error = 0.0, uv_error = 0.0;
+        for (int i = 0; i < mesh.vertex_count; i++) {
+            const float *a = mesh.vertices + i * 8;
+            const float *b = decoded + i * 8;
+            for (int c = 0; c < 3; c++) pos_error = fmax(pos_error, fabs(a[c] - b[c]));
+            double len_a = sqrt(a[3] * a[3] + a[4] * a[4] + a[5] * a[5]);
+            double len_b = sqrt(b[3] * b[3] + b[4] * b[4] + b[5] * b[5]);
+            double cos_angle = (a[3] * b[3] + a[4] * b[4] + a[5] * b[5]) / (len_a * len_b);
+            cos_angle = cos_angle > 1.0 ? 1.0 : cos_angle;
+            normal_error = fmax(normal_error, acos(cos_angle) * 180.0 / 3.14159265358979);
+            uv_error = fmax(uv_error, fmax(fabs(a[6] - b[6]), fabs(a[7] - b[7])));
+        }
+
+        printf("%-11s %8d %10.2f %11.2f %12.2f %12.2e %12.4f %10.2e\n",
+               vertex_format_name(format), layout.stride, bytes / (1024.0 * 1024.0), encode_ms,
+               bytes / fetch_seconds / 1e9, pos_error, normal_error, uv_error);
+        packed_vertices_free(&packed);
+    }
+
+    free(decoded);
+    mesh_free(&mesh);
+    return 0;
+}
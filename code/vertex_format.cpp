@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "vertex_format.h"
+
+#define SOURCE_STRIDE 8
+
+const char *vertex_format_name(Vertex_Format format) {
+    switch (format) {
+    case VERTEX_FORMAT_FLOAT: return "float";
+    case VERTEX_FORMAT_PACKED: return "packed";
+    case VERTEX_FORMAT_OCTAHEDRAL: return "octahedral";
+    default: return "unknown";
+    }
+}
+
+Vertex_Layout vertex_layout_float(const int *sizes, int count) {
+    assert(count <= VERTEX_LAYOUT_MAX_ATTRIBS);
+    Vertex_Layout layout{};
+    layout.attrib_count = count;
+    int offset = 0;
+    for (int i = 0; i < count; i++) {
+        layout.attribs[i] = {sizes[i], GL_FLOAT, false, offset};
+        offset += sizes[i] * (int)sizeof(float);
+    }
+    layout.stride = offset;
+    return layout;
+}
+
+Vertex_Layout vertex_format_layout(Vertex_Format format) {
+    Vertex_Layout layout{};
+    layout.attrib_count = 3;
+    switch (format) {
+    case VERTEX_FORMAT_FLOAT: {
+        int sizes[] = {3, 3, 2};
+        layout = vertex_layout_float(sizes, 3);
+    } break;
+    case VERTEX_FORMAT_PACKED:
+        layout.attribs[0] = {3, GL_UNSIGNED_SHORT, true, 0};
+        layout.attribs[1] = {4, GL_INT_2_10_10_10_REV, true, 8};
+        layout.attribs[2] = {2, GL_HALF_FLOAT, false, 12};
+        layout.stride = 16;
+        break;
+    case VERTEX_FORMAT_OCTAHEDRAL:
+        layout.attribs[0] = {3, GL_UNSIGNED_SHORT, true, 0};
+        layout.attribs[1] = {2, GL_SHORT, true, 8};
+        layout.attribs[2] = {2, GL_HALF_FLOAT, false, 12};
+        layout.stride = 16;
+        break;
+    default:
+        assert(0);
+    }
+    return layout;
+}
+
+uint16_t float_to_half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((x >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = x & 0x7FFFFF;
+
+    if (((x >> 23) & 0xFF) == 0xFF) {
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7C00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is correct
+    return (uint16_t)half;
+}
+
+float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t x;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            x = sign;
+        } else {
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            x = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    } else if (exponent == 31) {
+        x = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static uint16_t quantize_unorm16(float v) {
+    if (v < 0.0f) v = 0.0f;
+    if (v > 1.0f) v = 1.0f;
+    return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+static uint32_t pack_int_2_10_10_10(float x, float y, float z) {
+    float c[3] = {x, y, z};
+    uint32_t result = 0;
+    for (int i = 0; i < 3; i++) {
+        float v = c[i] < -1.0f ? -1.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+        int32_t q = (int32_t)floorf(v * 511.0f + 0.5f);
+        result |= ((uint32_t)q & 0x3FF) << (10 * i);
+    }
+    return result;
+}
+
+static float unpack_snorm10(uint32_t bits) {
+    int32_t v = (int32_t)(bits << 22) >> 22;
+    float f = (float)v / 511.0f;
+    return f < -1.0f ? -1.0f : f;
+}
+
+static float sign_not_zero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static void octahedral_encode(const float *n, float *out) {
+    float inv_l1 = 1.0f / (fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]));
+    float x = n[0] * inv_l1;
+    float y = n[1] * inv_l1;
+    if (n[2] < 0.0f) {
+        float fold_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+        float fold_y = (1.0f - fabsf(x)) * sign_not_zero(y);
+        x = fold_x;
+        y = fold_y;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+
+static void octahedral_decode(float x, float y, float *out) {
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f) {
+        float unfold_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+        float unfold_y = (1.0f - fabsf(x)) * sign_not_zero(y);
+        x = unfold_x;
+        y = unfold_y;
+    }
+    float len = sqrtf(x * x + y * y + z * z);
+    out[0] = x / len;
+    out[1] = y / len;
+    out[2] = z / len;
+}
+
+// Snap each component to the snorm16 neighbour that best preserves the direction
+static void octahedral_encode_snorm16(const float *n, int16_t *out) {
+    float e[2];
+    octahedral_encode(n, e);
+    int16_t base[2] = {(int16_t)floorf(e[0] * 32767.0f), (int16_t)floorf(e[1] * 32767.0f)};
+    float best_error = -2.0f;
+    for (int i = 0; i < 4; i++) {
+        int32_t qx = base[0] + (i & 1);
+        int32_t qy = base[1] + (i >> 1);
+        if (qx > 32767 || qy > 32767) continue;
+        float d[3];
+        octahedral_decode((float)qx / 32767.0f, (float)qy / 32767.0f, d);
+        float cos_angle = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+        if (cos_angle > best_error) {
+            best_error = cos_angle;
+            out[0] = (int16_t)qx;
+            out[1] = (int16_t)qy;
+        }
+    }
+}
+
+Packed_Vertices vertex_format_encode(const float *vertices, int vertex_count, Vertex_Format format) {
+    Packed_Vertices result{};
+    result.format = format;
+    result.vertex_count = vertex_count;
+    result.pos_scale[0] = result.pos_scale[1] = result.pos_scale[2] = 1.0f;
+    result.normal_encoding = format == VERTEX_FORMAT_OCTAHEDRAL ? NORMAL_ENCODING_OCTAHEDRAL : NORMAL_ENCODING_XYZ;
+
+    Vertex_Layout layout = vertex_format_layout(format);
+    result.data = malloc((size_t)vertex_count * layout.stride);
+
+    if (format == VERTEX_FORMAT_FLOAT) {
+        memcpy(result.data, vertices, (size_t)vertex_count * layout.stride);
+        return result;
+    }
+
+    float aabb_min[3] = {HUGE_VALF, HUGE_VALF, HUGE_VALF};
+    float aabb_max[3] = {-HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+    for (int i = 0; i < vertex_count; i++) {
+        for (int c = 0; c < 3; c++) {
+            float v = vertices[i * SOURCE_STRIDE + c];
+            if (v < aabb_min[c]) aabb_min[c] = v;
+            if (v > aabb_max[c]) aabb_max[c] = v;
+        }
+    }
+    float inv_extent[3];
+    for (int c = 0; c < 3; c++) {
+        float extent = vertex_count > 0 ? aabb_max[c] - aabb_min[c] : 0.0f;
+        result.pos_offset[c] = vertex_count > 0 ? aabb_min[c] : 0.0f;
+        result.pos_scale[c] = extent;
+        inv_extent[c] = extent > 0.0f ? 1.0f / extent : 0.0f;
+    }
+
+    for (int i = 0; i < vertex_count; i++) {
+        const float *src = vertices + i * SOURCE_STRIDE;
+        uint8_t *dst = (uint8_t *)result.data + i * layout.stride;
+
+        uint16_t pos[4];
+        for (int c = 0; c < 3; c++) {
+            pos[c] = quantize_unorm16((src[c] - result.pos_offset[c]) * inv_extent[c]);
+        }
+        pos[3] = 0;
+        memcpy(dst, pos, sizeof(pos));
+
+        if (format == VERTEX_FORMAT_PACKED) {
+            uint32_t normal = pack_int_2_10_10_10(src[3], src[4], src[5]);
+            memcpy(dst + 8, &normal, sizeof(normal));
+        } else {
+            int16_t normal[2];
+            octahedral_encode_snorm16(src + 3, normal);
+            memcpy(dst + 8, normal, sizeof(normal));
+        }
+
+        uint16_t uv[2] = {float_to_half(src[6]), float_to_half(src[7])};
+        memcpy(dst + 12, uv, sizeof(uv));
+    }
+    return result;
+}
+
+void vertex_format_decode(Packed_Vertices *packed, float *out_vertices) {
+    Vertex_Layout layout = vertex_format_layout(packed->format);
+    if (packed->format == VERTEX_FORMAT_FLOAT) {
+        memcpy(out_vertices, packed->data, (size_t)packed->vertex_count * layout.stride);
+        return;
+    }
+
+    for (int i = 0; i < packed->vertex_count; i++) {
+        const uint8_t *src = (const uint8_t *)packed->data + i * layout.stride;
+        float *dst = out_vertices + i * SOURCE_STRIDE;
+
+        uint16_t pos[4];
+        memcpy(pos, src, sizeof(pos));
+        for (int c = 0; c < 3; c++) {
+            dst[c] = packed->pos_offset[c] + ((float)pos[c] / 65535.0f) * packed->pos_scale[c];
+        }
+
+        if (packed->format == VERTEX_FORMAT_PACKED) {
+            uint32_t normal;
+            memcpy(&normal, src + 8, sizeof(normal));
+            float n[3];
+            for (int c = 0; c < 3; c++) n[c] = unpack_snorm10(normal >> (10 * c));
+            float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3; c++) dst[3 + c] = len > 0.0f ? n[c] / len : 0.0f;
+        } else {
+            int16_t normal[2];
+            memcpy(normal, src + 8, sizeof(normal));
+            float x = (float)normal[0] / 32767.0f;
+            float y = (float)normal[1] / 32767.0f;
+            octahedral_decode(x < -1.0f ? -1.0f : x, y < -1.0f ? -1.0f : y, dst + 3);
+        }
+
+        uint16_t uv[2];
+        memcpy(uv, src + 12, sizeof(uv));
+        dst[6] = half_to_float(uv[0]);
+        dst[7] = half_to_float(uv[1]);
+    }
+}
+
+void packed_vertices_free(Packed_Vertices *packed) {
+    free(packed->data);
+    *packed = {};
+}
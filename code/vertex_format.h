@@ -0,0 +1,59 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+
+// Storage formats for position/normal/uv vertices. Source vertices are always
+// 8 floats: position xyz, normal xyz, uv.
+enum Vertex_Format {
+    VERTEX_FORMAT_FLOAT,      // 3f position, 3f normal, 2f uv            (32 bytes)
+    VERTEX_FORMAT_PACKED,     // unorm16 position, 2_10_10_10 normal, 2h uv (16 bytes)
+    VERTEX_FORMAT_OCTAHEDRAL, // unorm16 position, snorm16x2 oct normal, 2h uv (16 bytes)
+    VERTEX_FORMAT_COUNT
+};
+
+// Values for the normal_encoding uniform in cube_v.glsl
+#define NORMAL_ENCODING_XYZ 0
+#define NORMAL_ENCODING_OCTAHEDRAL 1
+
+#define VERTEX_LAYOUT_MAX_ATTRIBS 8
+
+struct Vertex_Attrib {
+    int size;
+    GLenum type;
+    bool normalized;
+    int offset;
+};
+
+struct Vertex_Layout {
+    int stride;
+    int attrib_count;
+    Vertex_Attrib attribs[VERTEX_LAYOUT_MAX_ATTRIBS];
+};
+
+struct Packed_Vertices {
+    Vertex_Format format;
+    void *data;
+    int vertex_count;
+
+    // position = pos_offset + decoded * pos_scale
+    float pos_offset[3];
+    float pos_scale[3];
+    int normal_encoding;
+};
+
+const char *vertex_format_name(Vertex_Format format);
+Vertex_Layout vertex_format_layout(Vertex_Format format);
+// Layout for plain interleaved floats, sizes are component counts per attribute
+Vertex_Layout vertex_layout_float(const int *sizes, int count);
+
+Packed_Vertices vertex_format_encode(const float *vertices, int vertex_count, Vertex_Format format);
+// Reference decode back to 8 floats per vertex, mirrors cube_v.glsl
+void vertex_format_decode(Packed_Vertices *packed, float *out_vertices);
+void packed_vertices_free(Packed_Vertices *packed);
+
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+
+#endif // VERTEX_FORMAT_H
@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "virtual_texture.h"
+#include "texture_bake.h"
+#include "mip_gen.h"
+#include "job_system.h"
+#include "image_decode.h"
+#include "asset_pack.h"
+#include "memory_arena.h"
+#include "alloc_tracker.h"
+
+static const uint8_t VIRTUAL_TEXTURE_IDENTIFIER[12] = {0xAB, 'G', 'L', 'V', 'T', 'X', ' ', '1', 0xBB, '\r', '\n', 0x1A};
+
+#define PAGE_NONE -1
+
+enum Page_Load_State {
+    PAGE_LOAD_FREE,
+    PAGE_LOAD_READING,
+    PAGE_LOAD_READY,
+};
+
+static int padded_page_size(const Virtual_Texture_Header *header) {
+    return (int)(header->page_size + 2 * header->border);
+}
+
+static int level_pages_per_side(const Virtual_Texture *vt, int level) {
+    return vt->pages_per_side >> level;
+}
+
+static int page_index(const Virtual_Texture *vt, int level, int x, int y) {
+    return vt->level_first_page[level] + y * level_pages_per_side(vt, level) + x;
+}
+
+static void page_coords(const Virtual_Texture *vt, int page, int *out_level, int *out_x, int *out_y) {
+    int level = 0;
+    while (level + 1 < (int)vt->header->level_count && page >= vt->level_first_page[level + 1]) level++;
+    int local = page - vt->level_first_page[level];
+    *out_level = level;
+    *out_x = local % level_pages_per_side(vt, level);
+    *out_y = local / level_pages_per_side(vt, level);
+}
+
+static int next_pow2(int value) {
+    int pow2 = 1;
+    while (pow2 < value) pow2 <<= 1;
+    return pow2;
+}
+
+// Copies one page and its border out of a level, clamping at the edges
+static void cut_page(const uint8_t *level, int level_size, int page_x, int page_y, int page_size, int border, uint8_t *out) {
+    int padded = page_size + 2 * border;
+    for (int y = 0; y < padded; y++) {
+        int sy = page_y * page_size + y - border;
+        sy = sy < 0 ? 0 : (sy >= level_size ? level_size - 1 : sy);
+        for (int x = 0; x < padded; x++) {
+            int sx = page_x * page_size + x - border;
+            sx = sx < 0 ? 0 : (sx >= level_size ? level_size - 1 : sx);
+            memcpy(out + ((size_t)y * padded + x) * 4, level + ((size_t)sy * level_size + sx) * 4, 4);
+        }
+    }
+}
+
+// The source, the square level 0, the page index and the page being cut are
+// all scratch, only the smaller levels from mip_generate are malloc'd
+bool virtual_texture_bake(const char *source, const char *out_path) {
+    Arena *scratch = memory_thread_scratch();
+    Arena_Temp temp = arena_temp_begin(scratch);
+    int width, height, n;
+    uint8_t *pixels = image_load(source, &width, &height, &n, 4, true);
+    if (pixels == NULL) {
+        printf("Failed to load texture: %s\n", source);
+        return false;
+    }
+
+    Mip_Options mip_options{};
+    mip_options.filter = texture_bake_filter;
+    mip_options.srgb = true;
+
+    // square power of two, at least one page
+    int size = next_pow2(width > height ? width : height);
+    if (size < VIRTUAL_TEXTURE_PAGE_SIZE) size = VIRTUAL_TEXTURE_PAGE_SIZE;
+    uint8_t *square = ARENA_PUSH_ARRAY(scratch, uint8_t, (size_t)size * size * 4);
+    if (!square) {
+        printf("Out of scratch memory resampling %s\n", source);
+        arena_temp_end(temp);
+        return false;
+    }
+    mip_resample(pixels, width, height, square, size, size, &mip_options);
+
+    Virtual_Texture_Header header{};
+    memcpy(header.identifier, VIRTUAL_TEXTURE_IDENTIFIER, sizeof(header.identifier));
+    header.version = VIRTUAL_TEXTURE_VERSION;
+    header.size = size;
+    header.page_size = VIRTUAL_TEXTURE_PAGE_SIZE;
+    header.border = VIRTUAL_TEXTURE_BORDER;
+    header.gl_internal_format = GL_SRGB8_ALPHA8;
+    header.page_bytes = padded_page_size(&header) * padded_page_size(&header) * 4;
+    // down to the level that is a single page
+    header.level_count = mip_level_count(size / VIRTUAL_TEXTURE_PAGE_SIZE, 1);
+    if (header.level_count > VIRTUAL_TEXTURE_MAX_LEVELS) {
+        printf("Virtual texture %s is too large\n", source);
+        arena_temp_end(temp);
+        return false;
+    }
+    int pages_per_side = size / VIRTUAL_TEXTURE_PAGE_SIZE;
+    for (uint32_t level = 0; level < header.level_count; level++) {
+        int side = pages_per_side >> level;
+        header.page_count += side * side;
+    }
+
+    uint8_t *levels[16] = {square};
+    mip_generate(square, size, size, header.level_count, &mip_options, levels);
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", out_path);
+    FILE *fp = fopen(temp_path, "wb");
+    bool ok = fp != NULL;
+    if (ok) {
+        uint64_t *offsets = ARENA_PUSH_ARRAY(scratch, uint64_t, header.page_count);
+        uint64_t data_start = sizeof(header) + header.page_count * sizeof(uint64_t);
+        data_start = (data_start + BAKED_TEXTURE_ALIGNMENT - 1) / BAKED_TEXTURE_ALIGNMENT * BAKED_TEXTURE_ALIGNMENT;
+        for (uint32_t i = 0; i < header.page_count; i++) {
+            offsets[i] = data_start + (uint64_t)i * header.page_bytes;
+        }
+        static const uint8_t zeros[BAKED_TEXTURE_ALIGNMENT] = {};
+        size_t padding = (size_t)(data_start - sizeof(header) - header.page_count * sizeof(uint64_t));
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = ok && fwrite(offsets, sizeof(uint64_t), header.page_count, fp) == header.page_count;
+        ok = ok && (padding == 0 || fwrite(zeros, 1, padding, fp) == padding);
+
+        uint8_t *page = ARENA_PUSH_ARRAY(scratch, uint8_t, header.page_bytes);
+        for (uint32_t level = 0; ok && level < header.level_count; level++) {
+            int side = pages_per_side >> level;
+            for (int y = 0; ok && y < side; y++) {
+                for (int x = 0; ok && x < side; x++) {
+                    cut_page(levels[level], size >> level, x, y, header.page_size, header.border, page);
+                    ok = fwrite(page, 1, header.page_bytes, fp) == header.page_bytes;
+                }
+            }
+        }
+        ok = (fclose(fp) == 0) && ok;
+    }
+    for (uint32_t level = 1; level < header.level_count; level++) {
+        free(levels[level]);
+    }
+    arena_temp_end(temp);
+
+    if (!ok || !platform_replace_file(temp_path, out_path)) {
+        printf("Failed to write virtual texture: %s\n", out_path);
+        remove(temp_path);
+        return false;
+    }
+    printf("Baked %s -> %s (%d pages)\n", source, out_path, header.page_count);
+    return true;
+}
+
+static bool virtual_texture_parse(Virtual_Texture *vt) {
+    if (vt->file.size < (int64_t)sizeof(Virtual_Texture_Header)) return false;
+    const Virtual_Texture_Header *header = (const Virtual_Texture_Header *)vt->file.data;
+    if (memcmp(header->identifier, VIRTUAL_TEXTURE_IDENTIFIER, sizeof(header->identifier)) != 0) return false;
+    if (header->version != VIRTUAL_TEXTURE_VERSION) return false;
+    if (header->level_count == 0 || header->level_count > VIRTUAL_TEXTURE_MAX_LEVELS) return false;
+    if ((header->size >> (header->level_count - 1)) != header->page_size) return false;
+    // the page must be a power of two with content left inside its border
+    if (header->page_size == 0 || (header->page_size & (header->page_size - 1)) != 0) return false;
+    if ((uint64_t)header->page_size <= 2 * (uint64_t)header->border) return false;
+    uint64_t padded = (uint64_t)header->page_size + 2 * (uint64_t)header->border;
+    if (header->page_bytes != padded * padded * 4) return false;
+    int64_t index_end = sizeof(Virtual_Texture_Header) + header->page_count * sizeof(uint64_t);
+    if (vt->file.size < index_end) return false;
+    const uint64_t *offsets = (const uint64_t *)(header + 1);
+    uint64_t file_size = (uint64_t)vt->file.size;
+    for (uint32_t i = 0; i < header->page_count; i++) {
+        // compared without the sum, which a corrupt offset could wrap
+        if (offsets[i] > file_size || header->page_bytes > file_size - offsets[i]) return false;
+    }
+
+    vt->header = header;
+    vt->page_offsets = offsets;
+    vt->pages_per_side = header->size / header->page_size;
+    int first = 0;
+    for (uint32_t level = 0; level < header->level_count; level++) {
+        vt->level_first_page[level] = first;
+        first += level_pages_per_side(vt, level) * level_pages_per_side(vt, level);
+    }
+    return first == (int)header->page_count;
+}
+
+bool virtual_texture_ensure(const char *source, char *out_path, int out_size) {
+    char baked_path[512];
+    texture_bake_path(source, NULL, 0, baked_path, sizeof(baked_path));
+    // texture_bake_path ends in .0.gltex, the tiled file sits next to it
+    int n = (int)strlen(baked_path) - (int)strlen(".gltex");
+    snprintf(out_path, out_size, "%.*s.gvt", n, baked_path);
+
+    int64_t source_time = asset_mtime(source);
+    int64_t baked_time = platform_file_mtime(out_path);
+    if (baked_time >= 0 && baked_time >= source_time) return true;
+    if (source_time < 0) {
+        printf("Failed to load texture: %s\n", source);
+        return false;
+    }
+    platform_make_directory(BAKED_TEXTURE_DIRECTORY);
+    return virtual_texture_bake(source, out_path);
+}
+
+static void upload_page(Virtual_Texture *vt, int slot, const uint8_t *pixels) {
+    int padded = padded_page_size(vt->header);
+    int x = (slot % vt->cache_side) * padded;
+    int y = (slot / vt->cache_side) * padded;
+    glTextureSubImage2D(vt->physical, 0, x, y, padded, padded, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+static void feedback_create(Virtual_Texture *vt, int width, int height) {
+    if (vt->feedback_fbo) {
+        glDeleteFramebuffers(1, &vt->feedback_fbo);
+        glDeleteRenderbuffers(1, &vt->feedback_color);
+        glDeleteRenderbuffers(1, &vt->feedback_depth);
+    }
+    vt->feedback_width = width;
+    vt->feedback_height = height;
+    glCreateRenderbuffers(1, &vt->feedback_color);
+    glNamedRenderbufferStorage(vt->feedback_color, GL_RGBA8UI, width, height);
+    glCreateRenderbuffers(1, &vt->feedback_depth);
+    glNamedRenderbufferStorage(vt->feedback_depth, GL_DEPTH_COMPONENT24, width, height);
+    glCreateFramebuffers(1, &vt->feedback_fbo);
+    glNamedFramebufferRenderbuffer(vt->feedback_fbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedback_color);
+    glNamedFramebufferRenderbuffer(vt->feedback_fbo, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedback_depth);
+    assert(glCheckNamedFramebufferStatus(vt->feedback_fbo, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    for (int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++) {
+        if (vt->feedback_buffers[i]) glDeleteBuffers(1, &vt->feedback_buffers[i]);
+        if (vt->feedback_fences[i]) glDeleteSync(vt->feedback_fences[i]);
+        vt->feedback_fences[i] = 0;
+        glCreateBuffers(1, &vt->feedback_buffers[i]);
+        glNamedBufferStorage(vt->feedback_buffers[i], width * height * 4, NULL, GL_MAP_READ_BIT);
+    }
+}
+
+bool virtual_texture_open(Virtual_Texture *vt, const char *source, int cache_side) {
+    char path[512];
+    if (!virtual_texture_ensure(source, path, sizeof(path))) return false;
+    if (!platform_map_file(path, &vt->file)) return false;
+    // pages are read wherever the camera looks
+    platform_advise(&vt->file, 0, 0, PLATFORM_ACCESS_RANDOM);
+    if (!virtual_texture_parse(vt)) {
+        printf("Invalid virtual texture: %s\n", path);
+        platform_unmap_file(&vt->file);
+        return false;
+    }
+
+    const Virtual_Texture_Header *header = vt->header;
+    int padded = padded_page_size(header);
+    int slot_count = cache_side * cache_side;
+    vt->cache_side = cache_side;
+    glCreateTextures(GL_TEXTURE_2D, 1, &vt->physical);
+    glTextureStorage2D(vt->physical, 1, gl_storage_format(header->gl_internal_format), cache_side * padded, cache_side * padded);
+    glTextureParameteri(vt->physical, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(vt->physical, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(vt->physical, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(vt->physical, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    int indirection_texels = 0;
+    for (uint32_t level = 0; level < header->level_count; level++) {
+        indirection_texels += level_pages_per_side(vt, level) * level_pages_per_side(vt, level);
+    }
+    glCreateTextures(GL_TEXTURE_2D, 1, &vt->indirection);
+    glTextureStorage2D(vt->indirection, header->level_count, GL_RGBA8UI, vt->pages_per_side, vt->pages_per_side);
+    glTextureParameteri(vt->indirection, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(vt->indirection, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    vt->indirection_data = (uint8_t *)calloc(indirection_texels, 4);
+
+    vt->slot_page = (int *)malloc(slot_count * sizeof(int));
+    vt->slot_used = (uint64_t *)calloc(slot_count, sizeof(uint64_t));
+    for (int i = 0; i < slot_count; i++) vt->slot_page[i] = PAGE_NONE;
+    vt->page_slot = (int *)malloc(header->page_count * sizeof(int));
+    for (uint32_t i = 0; i < header->page_count; i++) vt->page_slot[i] = PAGE_NONE;
+    vt->page_loading = (uint8_t *)calloc(header->page_count, 1);
+    vt->page_seen = (uint32_t *)calloc(header->page_count, sizeof(uint32_t));
+    vt->requests = (int *)malloc(header->page_count * sizeof(int));
+    vt->request_count = 0;
+    vt->feedback_stamp = 0;
+    vt->feedback_next = 0;
+    vt->frame = 1;
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS; i++) {
+        vt->loads[i].state.store(PAGE_LOAD_FREE);
+        vt->loads[i].pixels = (uint8_t *)malloc(header->page_bytes);
+    }
+
+    // slot 0 always holds the single page of the coarsest level
+    int root = page_index(vt, header->level_count - 1, 0, 0);
+    upload_page(vt, 0, (const uint8_t *)vt->file.data + vt->page_offsets[root]);
+    vt->slot_page[0] = root;
+    vt->page_slot[root] = 0;
+    vt->indirection_dirty = true;
+
+    printf("Virtual texture %s: %ux%u, %u levels, %u pages, %d KB resident\n", source, header->size, header->size,
+           header->level_count, header->page_count, (int)(virtual_texture_resident_bytes(vt) / 1024));
+    return true;
+}
+
+void virtual_texture_close(Virtual_Texture *vt) {
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS; i++) {
+        free(vt->loads[i].pixels);
+        vt->loads[i].pixels = NULL;
+    }
+    free(vt->slot_page);
+    free(vt->slot_used);
+    free(vt->page_slot);
+    free(vt->page_loading);
+    free(vt->page_seen);
+    free(vt->requests);
+    free(vt->indirection_data);
+    glDeleteTextures(1, &vt->physical);
+    glDeleteTextures(1, &vt->indirection);
+    glDeleteFramebuffers(1, &vt->feedback_fbo);
+    glDeleteRenderbuffers(1, &vt->feedback_color);
+    glDeleteRenderbuffers(1, &vt->feedback_depth);
+    for (int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++) {
+        glDeleteBuffers(1, &vt->feedback_buffers[i]);
+        if (vt->feedback_fences[i]) glDeleteSync(vt->feedback_fences[i]);
+        vt->feedback_buffers[i] = 0;
+        vt->feedback_fences[i] = 0;
+    }
+    vt->feedback_fbo = 0;
+    platform_unmap_file(&vt->file);
+    vt->header = NULL;
+}
+
+void virtual_texture_begin_feedback(Virtual_Texture *vt, int width, int height) {
+    int feedback_width = width / VIRTUAL_TEXTURE_FEEDBACK_SCALE > 0 ? width / VIRTUAL_TEXTURE_FEEDBACK_SCALE : 1;
+    int feedback_height = height / VIRTUAL_TEXTURE_FEEDBACK_SCALE > 0 ? height / VIRTUAL_TEXTURE_FEEDBACK_SCALE : 1;
+    if (!vt->feedback_fbo || feedback_width != vt->feedback_width || feedback_height != vt->feedback_height) {
+        feedback_create(vt, feedback_width, feedback_height);
+    }
+
+    glGetIntegerv(GL_VIEWPORT, vt->saved_viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+    glViewport(0, 0, feedback_width, feedback_height);
+    GLuint none[4] = {};
+    glClearBufferuiv(GL_COLOR, 0, none);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void virtual_texture_end_feedback(Virtual_Texture *vt) {
+    int index = vt->feedback_next;
+    // still waiting on this buffer from a previous frame, skip this readback
+    if (!vt->feedback_fences[index]) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_buffers[index]);
+        glReadPixels(0, 0, vt->feedback_width, vt->feedback_height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        vt->feedback_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        vt->feedback_sizes[index][0] = vt->feedback_width;
+        vt->feedback_sizes[index][1] = vt->feedback_height;
+        vt->feedback_next = (index + 1) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(vt->saved_viewport[0], vt->saved_viewport[1], vt->saved_viewport[2], vt->saved_viewport[3]);
+}
+
+// Marks a requested page and its ancestors as used, queueing the ones that
+// are neither resident nor loading
+static void request_page(Virtual_Texture *vt, int level, int x, int y) {
+    for (; level < (int)vt->header->level_count; level++, x >>= 1, y >>= 1) {
+        int page = page_index(vt, level, x, y);
+        if (vt->page_seen[page] == vt->feedback_stamp) return;
+        vt->page_seen[page] = vt->feedback_stamp;
+        if (vt->page_slot[page] != PAGE_NONE) {
+            vt->slot_used[vt->page_slot[page]] = vt->frame;
+        } else if (!vt->page_loading[page]) {
+            vt->requests[vt->request_count++] = page;
+        }
+    }
+}
+
+static int compare_pages_coarse_first(const void *a, const void *b) {
+    // later pages are in coarser levels
+    return *(const int *)b - *(const int *)a;
+}
+
+static void read_feedback(Virtual_Texture *vt) {
+    int index = vt->feedback_next;
+    for (int i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_BUFFERS; i++, index = (index + 1) % VIRTUAL_TEXTURE_FEEDBACK_BUFFERS) {
+        GLsync fence = vt->feedback_fences[index];
+        if (!fence) continue;
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+        glDeleteSync(fence);
+        vt->feedback_fences[index] = 0;
+
+        int width = vt->feedback_sizes[index][0];
+        int height = vt->feedback_sizes[index][1];
+        if (width != vt->feedback_width || height != vt->feedback_height) continue; // resized since
+        const uint8_t *texels = (const uint8_t *)glMapNamedBufferRange(vt->feedback_buffers[index], 0, width * height * 4, GL_MAP_READ_BIT);
+        if (!texels) continue;
+
+        vt->feedback_stamp++;
+        vt->request_count = 0;
+        for (int t = 0; t < width * height; t++) {
+            const uint8_t *texel = texels + t * 4;
+            if (texel[3] == 0) continue; // nothing using the texture here
+            int level = texel[2];
+            int side = level < (int)vt->header->level_count ? level_pages_per_side(vt, level) : 0;
+            if (texel[0] >= side || texel[1] >= side) continue;
+            request_page(vt, level, texel[0], texel[1]);
+        }
+        glUnmapNamedBuffer(vt->feedback_buffers[index]);
+        qsort(vt->requests, vt->request_count, sizeof(int), compare_pages_coarse_first);
+    }
+}
+
+static void load_page(void *data) {
+    Virtual_Page_Load *load = (Virtual_Page_Load *)data;
+    // touching the mapping here takes the disk read off the GL thread
+    memcpy(load->pixels, load->source, load->size);
+    load->state.store(PAGE_LOAD_READY, std::memory_order_release);
+}
+
+static void start_loads(Virtual_Texture *vt) {
+    int next = 0;
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS && next < vt->request_count; i++) {
+        Virtual_Page_Load *load = &vt->loads[i];
+        if (load->state.load(std::memory_order_acquire) != PAGE_LOAD_FREE) continue;
+        int page = vt->requests[next++];
+        if (vt->page_slot[page] != PAGE_NONE || vt->page_loading[page]) {
+            i--;
+            continue;
+        }
+        vt->page_loading[page] = 1;
+        load->page = page;
+        load->source = (const uint8_t *)vt->file.data + vt->page_offsets[page];
+        load->size = vt->header->page_bytes;
+        load->state.store(PAGE_LOAD_READING, std::memory_order_relaxed);
+        job_run(load_page, load, NULL);
+    }
+    // whatever did not start is asked for again by the next feedback
+    vt->request_count = 0;
+}
+
+// Least recently used slot that the latest feedback did not ask for
+static int evict_slot(Virtual_Texture *vt) {
+    int slot_count = vt->cache_side * vt->cache_side;
+    int best = PAGE_NONE;
+    for (int slot = 1; slot < slot_count; slot++) {
+        if (vt->slot_page[slot] == PAGE_NONE) return slot;
+        if (vt->page_seen[vt->slot_page[slot]] == vt->feedback_stamp) continue;
+        if (best == PAGE_NONE || vt->slot_used[slot] < vt->slot_used[best]) best = slot;
+    }
+    if (best != PAGE_NONE) {
+        vt->page_slot[vt->slot_page[best]] = PAGE_NONE;
+        vt->slot_page[best] = PAGE_NONE;
+    }
+    return best;
+}
+
+static void finish_loads(Virtual_Texture *vt) {
+    int uploads = 0;
+    for (int i = 0; i < VIRTUAL_TEXTURE_MAX_LOADS && uploads < VIRTUAL_TEXTURE_UPLOADS_PER_FRAME; i++) {
+        Virtual_Page_Load *load = &vt->loads[i];
+        if (load->state.load(std::memory_order_acquire) != PAGE_LOAD_READY) continue;
+
+        int slot = evict_slot(vt);
+        if (slot != PAGE_NONE) {
+            upload_page(vt, slot, load->pixels);
+            vt->slot_page[slot] = load->page;
+            vt->slot_used[slot] = vt->frame;
+            vt->page_slot[load->page] = slot;
+            vt->indirection_dirty = true;
+            uploads++;
+        }
+        // with every slot in view the page is dropped and asked for again later
+        vt->page_loading[load->page] = 0;
+        load->state.store(PAGE_LOAD_FREE, std::memory_order_relaxed);
+    }
+}
+
+// Each page points to itself when resident, else to what its parent points to
+static void update_indirection(Virtual_Texture *vt) {
+    int level_count = (int)vt->header->level_count;
+    uint8_t *levels[VIRTUAL_TEXTURE_MAX_LEVELS];
+    uint8_t *texel = vt->indirection_data;
+    for (int level = 0; level < level_count; level++) {
+        levels[level] = texel;
+        texel += level_pages_per_side(vt, level) * level_pages_per_side(vt, level) * 4;
+    }
+
+    for (int level = level_count - 1; level >= 0; level--) {
+        int side = level_pages_per_side(vt, level);
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                uint8_t *entry = levels[level] + (y * side + x) * 4;
+                int slot = vt->page_slot[page_index(vt, level, x, y)];
+                if (slot != PAGE_NONE) {
+                    entry[0] = (uint8_t)(slot % vt->cache_side);
+                    entry[1] = (uint8_t)(slot / vt->cache_side);
+                    entry[2] = (uint8_t)level;
+                    entry[3] = 255;
+                } else {
+                    int parent_side = level_pages_per_side(vt, level + 1);
+                    memcpy(entry, levels[level + 1] + ((y >> 1) * parent_side + (x >> 1)) * 4, 4);
+                }
+            }
+        }
+        glTextureSubImage2D(vt->indirection, level, 0, 0, side, side, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, levels[level]);
+    }
+    vt->indirection_dirty = false;
+}
+
+void virtual_texture_update(Virtual_Texture *vt) {
+    ALLOC_ZONE("virtual_texture");
+    vt->frame++;
+    read_feedback(vt);
+    start_loads(vt);
+    finish_loads(vt);
+    if (vt->indirection_dirty) {
+        update_indirection(vt);
+    }
+}
+
+void virtual_texture_bind(Virtual_Texture *vt, GLuint shader, int physical_unit, int indirection_unit, bool feedback) {
+    const Virtual_Texture_Header *header = vt->header;
+    int padded = padded_page_size(header);
+    glBindTextureUnit(physical_unit, vt->physical);
+    glBindTextureUnit(indirection_unit, vt->indirection);
+    glUniform1i(glGetUniformLocation(shader, "vt_physical"), physical_unit);
+    glUniform1i(glGetUniformLocation(shader, "vt_indirection"), indirection_unit);
+    glUniform1f(glGetUniformLocation(shader, "vt_size"), (float)header->size);
+    glUniform1f(glGetUniformLocation(shader, "vt_page_size"), (float)header->page_size);
+    glUniform1f(glGetUniformLocation(shader, "vt_border"), (float)header->border);
+    glUniform1f(glGetUniformLocation(shader, "vt_physical_size"), (float)(vt->cache_side * padded));
+    glUniform1f(glGetUniformLocation(shader, "vt_padded_page_size"), (float)padded);
+    glUniform1f(glGetUniformLocation(shader, "vt_max_level"), (float)(header->level_count - 1));
+    // derivatives in the small feedback target are that many times larger
+    float bias = feedback ? -log2f((float)VIRTUAL_TEXTURE_FEEDBACK_SCALE) : 0.0f;
+    glUniform1f(glGetUniformLocation(shader, "vt_lod_bias"), bias);
+}
+
+int64_t virtual_texture_resident_bytes(Virtual_Texture *vt) {
+    int64_t physical_side = (int64_t)vt->cache_side * padded_page_size(vt->header);
+    int64_t indirection = 0;
+    for (uint32_t level = 0; level < vt->header->level_count; level++) {
+        indirection += level_pages_per_side(vt, level) * level_pages_per_side(vt, level) * 4;
+    }
+    return physical_side * physical_side * 4 + indirection;
+}
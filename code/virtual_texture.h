@@ -0,0 +1,121 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <glad/glad.h>
+
+#include "platform.h"
+
+// Software virtual texturing with core GL only. The source is baked once
+// into a tiled file of bordered pages, every mip level cut into pages. At
+// runtime a fixed size physical cache texture holds the resident pages and
+// an integer indirection texture, one texel per page and one mip per level,
+// points each page to the finest resident page covering it. A low resolution
+// feedback pass writes the page each pixel wants; the pages it reports are
+// read on the job system from the memory mapped file and uploaded a few per
+// frame, evicting the least recently used. The coarsest level is one page,
+// always resident, so there is always something to sample.
+//
+// The lookup itself is vt_sample in vt_f.glsl.
+
+#define VIRTUAL_TEXTURE_VERSION 1
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128
+#define VIRTUAL_TEXTURE_BORDER 4
+#define VIRTUAL_TEXTURE_MAX_LEVELS 12
+#define VIRTUAL_TEXTURE_MAX_LOADS 8
+#define VIRTUAL_TEXTURE_UPLOADS_PER_FRAME 4
+// feedback is rendered at 1 / VIRTUAL_TEXTURE_FEEDBACK_SCALE of the screen
+#define VIRTUAL_TEXTURE_FEEDBACK_SCALE 8
+#define VIRTUAL_TEXTURE_FEEDBACK_BUFFERS 2
+
+struct Virtual_Texture_Header {
+    uint8_t identifier[12];
+    uint32_t version;
+    uint32_t size;       // level 0 is size x size, a power of two
+    uint32_t page_size;  // texels of content per page side
+    uint32_t border;     // texels copied from the neighbours on each side
+    uint32_t level_count;
+    uint32_t gl_internal_format;
+    uint32_t page_bytes; // RGBA8, (page_size + 2 * border)^2 texels
+    uint32_t page_count;
+    uint32_t reserved;
+    // followed by uint64_t page_offsets[page_count], levels in order,
+    // pages row by row within a level
+};
+
+// A page read on a worker
+struct Virtual_Page_Load {
+    std::atomic<int> state;
+    int page;
+    uint8_t *pixels;
+    const uint8_t *source;
+    int size;
+};
+
+struct Virtual_Texture {
+    Platform_Mapped_File file;
+    const Virtual_Texture_Header *header;
+    const uint64_t *page_offsets;
+    int level_first_page[VIRTUAL_TEXTURE_MAX_LEVELS];
+    int pages_per_side; // at level 0
+
+    // physical page cache
+    GLuint physical;
+    int cache_side; // pages per side
+    int *slot_page; // page held by each slot, -1 if free
+    uint64_t *slot_used; // frame the slot was last asked for
+    int *page_slot; // slot of each page, -1 if not resident
+    uint8_t *page_loading;
+
+    GLuint indirection;
+    uint8_t *indirection_data; // RGBA8UI per level, back to back
+    bool indirection_dirty;
+
+    Virtual_Page_Load loads[VIRTUAL_TEXTURE_MAX_LOADS];
+    int *requests; // pages asked for by the last feedback, coarse first
+    int request_count;
+    uint32_t *page_seen;
+    uint32_t feedback_stamp;
+
+    GLuint feedback_fbo;
+    GLuint feedback_color;
+    GLuint feedback_depth;
+    int feedback_width;
+    int feedback_height;
+    GLuint feedback_buffers[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS];
+    GLsync feedback_fences[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS];
+    int feedback_sizes[VIRTUAL_TEXTURE_FEEDBACK_BUFFERS][2];
+    int feedback_next;
+    GLint saved_viewport[4];
+
+    uint64_t frame;
+};
+
+// Bakes source to the tiled file at out_path
+bool virtual_texture_bake(const char *source, const char *out_path);
+// Bakes source unless the tiled file is newer, and names it in out_path.
+// No GL, so it can run on a worker ahead of virtual_texture_open.
+bool virtual_texture_ensure(const char *source, char *out_path, int out_size);
+// Bakes source if needed, maps it and creates the GL objects. The physical
+// cache holds cache_side x cache_side pages whatever the source size.
+bool virtual_texture_open(Virtual_Texture *vt, const char *source, int cache_side);
+// The job system must be shut down first
+void virtual_texture_close(Virtual_Texture *vt);
+
+// Draw the geometry using the texture with the VT_FEEDBACK variant between
+// these. Renders into the feedback target at a fraction of width x height.
+void virtual_texture_begin_feedback(Virtual_Texture *vt, int width, int height);
+void virtual_texture_end_feedback(Virtual_Texture *vt);
+
+// Once per frame: reads back finished feedback, starts page loads and
+// uploads finished pages. Never waits on the GPU or the workers.
+void virtual_texture_update(Virtual_Texture *vt);
+
+// Binds the cache and indirection textures and sets the vt_ uniforms
+void virtual_texture_bind(Virtual_Texture *vt, GLuint shader, int physical_unit, int indirection_unit, bool feedback);
+
+// Bytes of texture memory held, constant for a given cache size
+int64_t virtual_texture_resident_bytes(Virtual_Texture *vt);
+
+#endif // VIRTUAL_TEXTURE_H
@@ -1,13 +1,15 @@
-#version 330 core
+#version 450 core
 in vec2 tex_coord;
 in vec3 normal;
 in vec3 posh;
+flat in uint layer;
 
 out vec4 out_color;
 
 struct Material {
-    sampler2D diffuse_map;
-    sampler2D specular_map;
+    // one layer per material
+    sampler2DArray diffuse_map;
+    sampler2DArray specular_map;
     float shininess;
 };
 
@@ -48,14 +50,19 @@ uniform Directional_Light dir_source;
 uniform Point_Light point_source;
 uniform Spot_Light spot_source;
 
+// Read once per fragment. With PACKED_SPECULAR the specular mask lives in
+// the diffuse alpha and the material needs a single texture.
+vec3 albedo;
+float specular_mask;
+
 vec3 compute_directional_light(Directional_Light light, vec3 normal, vec3 eye_dir) {
     vec3 light_dir = normalize(-light.direction);
     vec3 reflect_dir = reflect(-light_dir, normal);
-    vec3 ambient = light.ambient * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 ambient = light.ambient * albedo;
     float diff = max(dot(normal, light_dir), 0.0);
-    vec3 diffuse = diff * light.diffuse * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 diffuse = diff * light.diffuse * albedo;
     float spec = pow(max(dot(eye_dir, reflect_dir), 0.0), material.shininess);
-    vec3 specular = spec * light.specular * texture(material.specular_map, tex_coord).rgb;
+    vec3 specular = spec * light.specular * specular_mask;
 
     return ambient + diffuse + specular;
 }
@@ -65,11 +72,11 @@ vec3 compute_point_light(Point_Light light, vec3 normal, vec3 eye_dir) {
     float dist = length(light.position - posh);
     vec3 reflect_dir = reflect(-light_dir, normal);
     
-    vec3 ambient = light.ambient * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 ambient = light.ambient * albedo;
     float diff = max(dot(normal, light_dir), 0.0);
-    vec3 diffuse = diff * light.diffuse * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 diffuse = diff * light.diffuse * albedo;
     float spec = pow(max(dot(eye_dir, reflect_dir), 0.0), material.shininess);
-    vec3 specular = spec * light.specular * texture(material.specular_map, tex_coord).rgb;
+    vec3 specular = spec * light.specular * specular_mask;
 
     float attenuation = (1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist));
 
@@ -82,14 +89,14 @@ vec3 compute_point_light(Point_Light light, vec3 normal, vec3 eye_dir) {
 vec3 compute_spot_light(Spot_Light light, vec3 normal, vec3 eye_dir) {
     vec3 light_dir = normalize(light.position - posh);
     float theta = dot(light_dir, normalize(-light.direction));
-    vec3 ambient = light.ambient * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 ambient = light.ambient * albedo;
 
     float diff = max(dot(normal, light_dir), 0.0);
-    vec3 diffuse = diff * light.diffuse * texture(material.diffuse_map, tex_coord).rgb;
+    vec3 diffuse = diff * light.diffuse * albedo;
 
     vec3 reflect_dir = reflect(-light_dir, normal);
     float spec = pow(max(dot(eye_dir, reflect_dir), 0.0), material.shininess);
-    vec3 specular = spec * light.specular * texture(material.specular_map, tex_coord).rgb;
+    vec3 specular = spec * light.specular * specular_mask;
 
     float epsilon = light.cut_off - light.outer_cut_off;
     float intensity = clamp((theta - light.outer_cut_off) / epsilon, 0.0, 1.0);
@@ -101,6 +108,14 @@ vec3 compute_spot_light(Spot_Light light, vec3 normal, vec3 eye_dir) {
 }
 
 void main() {
+    vec4 diffuse_texel = texture(material.diffuse_map, vec3(tex_coord, layer));
+    albedo = diffuse_texel.rgb;
+#ifdef PACKED_SPECULAR
+    specular_mask = diffuse_texel.a;
+#else
+    specular_mask = texture(material.specular_map, vec3(tex_coord, layer)).r;
+#endif
+
     vec3 norm = normalize(normal);
     vec3 eye_dir = normalize(eye_pos - posh);
 
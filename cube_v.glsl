@@ -1,18 +1,47 @@
-#version 330 core
+#version 450 core
 layout (location = 0) in vec3 a_pos;
-layout (location = 1) in vec3 a_normal;
+layout (location = 1) in vec4 a_normal;
 layout (location = 2) in vec2 a_coord;
 
-uniform mat4 wvp;
-uniform mat4 world;
+// one per crate, see Crate_Instance in main.cpp
+struct Instance {
+    mat4 world;
+    uint layer;
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+uniform mat4 view_projection;
+
+// vertex decode, see vertex_format.h
+uniform vec3 pos_offset;
+uniform vec3 pos_scale;
+uniform int normal_encoding;
 
 out vec2 tex_coord;
 out vec3 normal;
 out vec3 posh;
+flat out uint layer;
+
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = wvp * vec4(a_pos, 1.0);
-    posh = vec3(world * vec4(a_pos, 1.0));
-    normal = mat3(transpose(inverse(world))) * a_normal;
+    vec3 pos = pos_offset + a_pos * pos_scale;
+    vec3 n = normal_encoding == 1 ? octahedral_decode(a_normal.xy) : a_normal.xyz;
+
+    mat4 world = instances[gl_InstanceID].world;
+    posh = vec3(world * vec4(pos, 1.0));
+    gl_Position = view_projection * vec4(posh, 1.0);
+    normal = mat3(transpose(inverse(world))) * n;
     tex_coord = a_coord;
+    layer = instances[gl_InstanceID].layer;
 };
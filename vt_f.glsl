@@ -0,0 +1,53 @@
+#version 450 core
+in vec2 tex_coord;
+in vec3 normal;
+
+// Virtual texture lookup, see virtual_texture.h. With VT_FEEDBACK the pass
+// writes the page it wants instead of shading.
+uniform usampler2D vt_indirection; // xy physical page, z resident level
+uniform sampler2D vt_physical;
+uniform float vt_size;
+uniform float vt_page_size;
+uniform float vt_border;
+uniform float vt_padded_page_size;
+uniform float vt_physical_size;
+uniform float vt_max_level;
+uniform float vt_lod_bias;
+
+uniform vec3 light_direction;
+
+#ifdef VT_FEEDBACK
+out uvec4 out_page;
+#else
+out vec4 out_color;
+#endif
+
+float vt_level(vec2 uv) {
+    vec2 dx = dFdx(uv * vt_size);
+    vec2 dy = dFdy(uv * vt_size);
+    float rho = max(dot(dx, dx), dot(dy, dy));
+    return clamp(0.5 * log2(max(rho, 1e-8)) + vt_lod_bias, 0.0, vt_max_level);
+}
+
+vec4 vt_sample(vec2 uv, int level) {
+    ivec2 page = ivec2(uv * vec2(textureSize(vt_indirection, level)));
+    uvec4 entry = texelFetch(vt_indirection, page, level);
+    // the entry may point to a coarser page that covers this one
+    float resident_pages = vt_size / vt_page_size / exp2(float(entry.z));
+    vec2 in_page = fract(uv * resident_pages) * vt_page_size + vt_border;
+    vec2 texel = vec2(entry.xy) * vt_padded_page_size + in_page;
+    return textureLod(vt_physical, texel / vt_physical_size, 0.0);
+}
+
+void main() {
+    vec2 uv = clamp(tex_coord, 0.0, 0.99999);
+    int level = int(vt_level(uv));
+#ifdef VT_FEEDBACK
+    ivec2 page = ivec2(uv * vec2(textureSize(vt_indirection, level)));
+    out_page = uvec4(page, level, 1);
+#else
+    vec3 albedo = vt_sample(uv, level).rgb;
+    float lambert = max(dot(normalize(normal), normalize(-light_direction)), 0.0);
+    out_color = vec4(albedo * (0.2 + 0.8 * lambert), 1.0);
+#endif
+}
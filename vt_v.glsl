@@ -0,0 +1,16 @@
+#version 450 core
+layout (location = 0) in vec3 a_pos;
+layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_tex_coord;
+
+out vec2 tex_coord;
+out vec3 normal;
+
+uniform mat4 world;
+uniform mat4 view_projection;
+
+void main() {
+    tex_coord = a_tex_coord;
+    normal = mat3(world) * a_normal;
+    gl_Position = view_projection * world * vec4(a_pos, 1.0);
+}